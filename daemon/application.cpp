@@ -69,32 +69,32 @@ toml::table setup_toml_configuration(std::filesystem::path const& config_path) {
 void setup_di_container(kgr::container& container) {
     using namespace bxt;
 
-    auto scheduler = coro::io_scheduler::make_shared({
-        .thread_strategy = coro::io_scheduler::thread_strategy_t::manual,
-    });
-
-    container.emplace<di::Utilities::IOScheduler>(scheduler);
-
-    container.service<di::Utilities::EventBus>();
-
-    container.service<di::Infrastructure::EventLogger>();
-
-    container.service<di::Utilities::EventBusDispatcher>();
-
     container.emplace<di::Utilities::Configuration>(setup_toml_configuration("config.toml"));
 
     // Invoke all options structures to deserialize their values
-    container.invoke<di::Utilities::Configuration, di::Utilities::LMDB::LMDBOptions,
-                     di::Persistence::Box::BoxOptions, di::Presentation::JwtOptions,
+    container.invoke<di::Utilities::Configuration, di::Utilities::SchedulerOptions,
+                     di::Utilities::LMDB::LMDBOptions, di::Persistence::Box::BoxOptions,
+                     di::Persistence::Box::WritebackOptions, di::Presentation::JwtOptions,
                      di::Presentation::DeploymentOptions>(
-        [](auto& configuration, auto& lmdb_options, auto& box_options, auto& jwt_options,
-           auto& deployment_options) {
+        [](auto& configuration, auto& scheduler_options, auto& lmdb_options, auto& box_options,
+           auto& writeback_options, auto& jwt_options, auto& deployment_options) {
+            scheduler_options.deserialize(configuration);
             lmdb_options.deserialize(configuration);
             box_options.deserialize(configuration);
+            writeback_options.deserialize(configuration);
             jwt_options.deserialize(configuration);
             deployment_options.deserialize(configuration);
         });
 
+    container.emplace<di::Utilities::IOScheduler>(
+        container.service<di::Utilities::SchedulerOptions>().make_scheduler());
+
+    container.service<di::Utilities::EventBus>();
+
+    container.service<di::Infrastructure::EventLogger>();
+
+    container.service<di::Utilities::EventBusDispatcher>();
+
     // Parse the repository schema from a YAML file and extend the parser with
     // custom options
     container.invoke<di::Utilities::RepoSchema::Parser, di::Infrastructure::ArchRepoOptions,
@@ -110,6 +110,8 @@ void setup_di_container(kgr::container& container) {
         [](auto lmdbenv, auto& options) {
             lmdbenv->env().set_mapsize(50UL * 1024UL * 1024UL * 1024UL);
             lmdbenv->env().set_max_dbs(128);
+            lmdbenv->env().set_max_readers(static_cast<unsigned int>(options.max_readers));
+            lmdbenv->set_concurrent_reads(options.concurrent_reads);
 
             std::error_code ec;
             if (std::filesystem::create_directories(options.lmdb_path, ec); ec.value()) {
@@ -118,7 +120,7 @@ void setup_di_container(kgr::container& container) {
             }
 
             try {
-                lmdbenv->env().open(options.lmdb_path.c_str(), 0, 0664);
+                lmdbenv->env().open(options.lmdb_path.c_str(), lmdbenv->open_flags(), 0664);
             } catch (lmdb::error const& er) {
                 logf("Cannot open LMDB database. The error is \"{}\". Exiting.", er.what());
                 exit(1);
@@ -141,6 +143,7 @@ void setup_di_container(kgr::container& container) {
 
     container.emplace<di::Persistence::Box::Pool>();
     container.emplace<di::Persistence::Box::LMDBPackageStore>("bxt::Box");
+    container.emplace<di::Persistence::Box::FileListStore>("bxt::Box::Files");
 
     container.emplace<di::Persistence::Box::AlpmDBExporter>();
 
@@ -174,13 +177,6 @@ void setup_controllers(drogon::HttpAppFramework& app, kgr::container& container)
         .registerFilter(container.service<JwtFilter>());
 }
 
-void setup_scheduler(auto& app, auto scheduler, auto eventbus) {
-    app.getLoop()->runEvery(1.0, [scheduler, eventbus]() {
-        scheduler->process_events();
-        eventbus->process();
-    });
-}
-
 void setup_defaults(kgr::container& container) {
     using namespace bxt;
     auto& unit_of_work_factory = container.service<di::Core::Domain::UnitOfWorkBaseFactory>();
@@ -260,8 +256,6 @@ int main() {
                            .setClientMaxBodySize(256 * 1024 * 1024)
                            .setClientMaxMemoryBodySize(1024 * 1024);
 
-    setup_scheduler(drogon_app, container.service<bxt::di::Utilities::IOScheduler>(),
-                    container.service<bxt::di::Utilities::EventBus>());
     setup_controllers(drogon_app, container);
 
     drogon_app.run();
@@ -0,0 +1,45 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/dtos/PackageSectionDTO.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace bxt::Core::Application {
+
+struct SyncPlanEntryDTO {
+    std::string name;
+    std::optional<std::string> local_version;
+    std::optional<std::string> remote_version;
+    // Compressed size of the package file
+    uint64_t size = 0;
+};
+
+// What a sync of the section would change, computed without running it
+struct SyncPlanDTO {
+    PackageSectionDTO section;
+
+    std::vector<SyncPlanEntryDTO> to_add;
+    std::vector<SyncPlanEntryDTO> to_update;
+    // Synced packages that are no longer in the upstream repository. A
+    // sync keeps them, they are listed to be removed by hand.
+    std::vector<SyncPlanEntryDTO> local_only;
+
+    // Size of the packages to add and update, and the part of it that is
+    // not in the download cache yet
+    uint64_t total_size = 0;
+    uint64_t download_size = 0;
+
+    // Why the section couldn't be planned, the plan is empty then
+    std::optional<std::string> error;
+};
+
+} // namespace bxt::Core::Application
@@ -10,7 +10,9 @@
 #include "core/domain/entities/Package.h"
 #include "core/domain/events/PackageEvents.h"
 
+#include <cstddef>
 #include <fmt/format.h>
+#include <string>
 #include <vector>
 
 namespace bxt::Core::Application::Events {
@@ -25,6 +27,25 @@ struct SyncStarted : public IntegrationEventBase {
     }
 };
 
+// Sent every time a chunk of a synced section is saved
+struct SyncProgress : public IntegrationEventBase {
+    SyncProgress() = default;
+    SyncProgress(std::string section, std::size_t saved_packages, std::size_t total_packages)
+        : section(std::move(section))
+        , saved_packages(saved_packages)
+        , total_packages(total_packages) {
+    }
+
+    std::string section;
+    std::size_t saved_packages = 0;
+    std::size_t total_packages = 0;
+
+    std::string message() const override {
+        return fmt::format("Sync of {}: {} of {} packages saved", section, saved_packages,
+                           total_packages);
+    }
+};
+
 struct SyncFinished : public IntegrationEventBase {
     SyncFinished() = default;
     SyncFinished(std::vector<Core::Domain::Package>&& packages,
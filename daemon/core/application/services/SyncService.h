@@ -7,6 +7,7 @@
 #pragma once
 
 #include "core/application/dtos/PackageSectionDTO.h"
+#include "core/application/dtos/SyncPlanDTO.h"
 #include "core/application/RequestContext.h"
 #include "utilities/Error.h"
 #include "utilities/errors/Macro.h"
@@ -14,6 +15,7 @@
 #include <coro/task.hpp>
 #include <frozen/string.h>
 #include <frozen/unordered_map.h>
+#include <vector>
 
 namespace bxt::Core::Application {
 
@@ -41,6 +43,11 @@ public:
     virtual coro::task<Result<void>> sync(PackageSectionDTO const section,
                                           RequestContext const context) = 0;
     virtual coro::task<Result<void>> sync_all(RequestContext const context) = 0;
+
+    // What sync_all would change in every section. Nothing is saved and no
+    // packages are downloaded. A section that can't be planned has its
+    // error set instead of failing the others.
+    virtual coro::task<std::vector<SyncPlanDTO>> plan_all() = 0;
 };
 
 } // namespace bxt::Core::Application
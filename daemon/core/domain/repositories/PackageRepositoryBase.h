@@ -13,6 +13,8 @@
 #include <core/domain/entities/Package.h>
 #include <core/domain/repositories/RepositoryBase.h>
 #include <functional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
 
 namespace bxt::Core::Domain {
 struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
@@ -30,5 +32,14 @@ struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
     virtual coro::task<TResult> find_by_section_async(Section const section,
                                                       Name const name,
                                                       std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    using VersionMap = phmap::flat_hash_map<std::string, PackageVersion>;
+
+    // Versions of all packages in the section by name, the same as
+    // Package::version() would give. Cheaper than loading the packages as
+    // the entities are never built.
+    virtual coro::task<ReadResult<VersionMap>>
+        find_versions_by_section_async(Section const section,
+                                       std::shared_ptr<UnitOfWorkBase> uow) = 0;
 };
 } // namespace bxt::Core::Domain
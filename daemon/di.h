@@ -32,8 +32,10 @@
 #include "persistence/box/pool/Pool.h"
 #include "persistence/box/pool/PoolBase.h"
 #include "persistence/box/pool/PoolOptions.h"
+#include "persistence/box/store/FileListStore.h"
 #include "persistence/box/store/LMDBPackageStore.h"
 #include "persistence/box/store/PackageStoreBase.h"
+#include "persistence/box/writeback/WritebackOptions.h"
 #include "persistence/box/writeback/WritebackScheduler.h"
 #include "persistence/config/SectionRepository.h"
 #include "persistence/lmdb/LmdbUnitOfWork.h"
@@ -53,6 +55,7 @@
 #include "utilities/lmdb/Environment.h"
 #include "utilities/lmdb/LMDBOptions.h"
 #include "utilities/repo-schema/Parser.h"
+#include "utilities/scheduler/SchedulerOptions.h"
 
 #include <infrastructure/EventLogger.h>
 #include <kangaru/autocall.hpp>
@@ -72,6 +75,8 @@ namespace Utilities {
         : kgr::single_service<bxt::Utilities::EventBusDispatcher,
                               kgr::dependency<di::Utilities::EventBus>> {};
 
+    struct SchedulerOptions : kgr::single_service<bxt::Utilities::SchedulerOptions> {};
+
     struct IOScheduler : kgr::extern_shared_service<coro::io_scheduler> {};
 
     namespace LMDB {
@@ -272,9 +277,9 @@ namespace Persistence {
                                                   di::Core::Domain::ReadOnlySectionRepository>>
             , kgr::overrides<PackageStoreBase> {};
 
-        struct WritebackScheduler
-            : kgr::single_service<bxt::Persistence::Box::WritebackScheduler,
-                                  kgr::dependency<Utilities::IOScheduler>> {};
+        struct FileListStore
+            : kgr::single_service<bxt::Persistence::Box::FileListStore,
+                                  kgr::dependency<di::Utilities::LMDB::Environment>> {};
 
         struct ExporterBase : kgr::abstract_service<bxt::Persistence::Box::ExporterBase> {};
 
@@ -282,14 +287,23 @@ namespace Persistence {
             : kgr::single_service<bxt::Persistence::Box::AlpmDBExporter,
                                   kgr::dependency<di::Persistence::Box::BoxOptions,
                                                   di::Persistence::Box::PackageStoreBase,
+                                                  di::Persistence::Box::FileListStore,
                                                   Core::Domain::ReadOnlySectionRepository,
                                                   di::Core::Domain::UnitOfWorkBaseFactory>>
             , kgr::overrides<ExporterBase> {};
 
+        struct WritebackOptions : kgr::single_service<bxt::Persistence::Box::WritebackOptions> {};
+
+        struct WritebackScheduler
+            : kgr::single_service<bxt::Persistence::Box::WritebackScheduler,
+                                  kgr::dependency<Utilities::IOScheduler,
+                                                  WritebackOptions,
+                                                  ExporterBase>> {};
+
         struct BoxRepository
             : kgr::single_service<
                   bxt::Persistence::Box::BoxRepository,
-                  kgr::dependency<BoxOptions, PackageStoreBase, WritebackScheduler, ExporterBase>>
+                  kgr::dependency<BoxOptions, PackageStoreBase, WritebackScheduler>>
             , kgr::overrides<di::Core::Domain::PackageRepositoryBase> {};
     } // namespace Box
 } // namespace Persistence
@@ -11,6 +11,9 @@
 #include "infrastructure/alpm/ArchRepoSource.h"
 #include "utilities/repo-schema/SchemaExtension.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <parallel_hashmap/phmap.h>
 #include <yaml-cpp/yaml.h>
@@ -21,6 +24,39 @@ struct ArchRepoOptions : public Utilities::RepoSchema::Extension {
     phmap::parallel_flat_hash_map<Core::Application::PackageSectionDTO, ArchRepoSource> sources;
     std::filesystem::path download_path = "/var/cache/bxt/packages";
 
+    // Idle keep-alive connections kept per mirror host
+    std::size_t connection_pool_size = 8;
+    std::chrono::seconds connection_idle_timeout {30};
+
+    // Downloads running at once, in total and per mirror host
+    std::size_t max_downloads = 8;
+    std::size_t max_downloads_per_host = 4;
+
+    // Attempts per download and the bounds of the backoff between them
+    int download_retries = 5;
+    std::chrono::milliseconds retry_base_delay {500};
+    std::chrono::milliseconds retry_max_delay {30000};
+
+    // Synced packages are built from the upstream desc once their SHA256 is
+    // verified. In paranoid mode every package is read and hashed again.
+    bool paranoid_verify = false;
+
+    // Downloaded packages of a section are saved together once there are
+    // this many of them, while the other downloads go on
+    std::size_t sync_chunk_size = 256;
+
+    // Packages already downloaded for another section are hard linked
+    // instead of downloaded again
+    bool deduplicate_downloads = true;
+
+    // Bytes the files left in the download path may take, 0 for no limit.
+    // Set in MiB by download-cache-size.
+    uint64_t download_cache_size = uint64_t {10240} * 1024 * 1024;
+
+    // Failures in a row after which a mirror is skipped, and for how long
+    std::size_t mirror_failure_threshold = 3;
+    std::chrono::milliseconds mirror_cooldown {30000};
+
     virtual void parse(const YAML::Node& root_node) override {
         constexpr char Tag[] = "(alpm.sync)";
 
@@ -29,6 +65,62 @@ struct ArchRepoOptions : public Utilities::RepoSchema::Extension {
         if (options_node["download-path"].IsDefined() && options_node["download-path"].IsScalar()) {
             download_path = options_node["download-path"].as<std::string>();
         }
+        if (options_node["connection-pool-size"].IsDefined()
+            && options_node["connection-pool-size"].IsScalar()) {
+            connection_pool_size = options_node["connection-pool-size"].as<std::size_t>();
+        }
+        if (options_node["connection-idle-timeout"].IsDefined()
+            && options_node["connection-idle-timeout"].IsScalar()) {
+            connection_idle_timeout =
+                std::chrono::seconds(options_node["connection-idle-timeout"].as<int64_t>());
+        }
+        if (options_node["max-downloads"].IsDefined() && options_node["max-downloads"].IsScalar()) {
+            max_downloads = options_node["max-downloads"].as<std::size_t>();
+        }
+        if (options_node["max-downloads-per-host"].IsDefined()
+            && options_node["max-downloads-per-host"].IsScalar()) {
+            max_downloads_per_host = options_node["max-downloads-per-host"].as<std::size_t>();
+        }
+        if (options_node["download-retries"].IsDefined()
+            && options_node["download-retries"].IsScalar()) {
+            download_retries = std::max(options_node["download-retries"].as<int>(), 1);
+        }
+        if (options_node["retry-base-delay"].IsDefined()
+            && options_node["retry-base-delay"].IsScalar()) {
+            retry_base_delay =
+                std::chrono::milliseconds(options_node["retry-base-delay"].as<int64_t>());
+        }
+        if (options_node["retry-max-delay"].IsDefined()
+            && options_node["retry-max-delay"].IsScalar()) {
+            retry_max_delay = std::chrono::milliseconds(options_node["retry-max-delay"].as<int64_t>());
+        }
+        if (options_node["paranoid-verify"].IsDefined()
+            && options_node["paranoid-verify"].IsScalar()) {
+            paranoid_verify = options_node["paranoid-verify"].as<bool>();
+        }
+        if (options_node["sync-chunk-size"].IsDefined()
+            && options_node["sync-chunk-size"].IsScalar()) {
+            sync_chunk_size =
+                std::max<std::size_t>(options_node["sync-chunk-size"].as<std::size_t>(), 1);
+        }
+        if (options_node["deduplicate-downloads"].IsDefined()
+            && options_node["deduplicate-downloads"].IsScalar()) {
+            deduplicate_downloads = options_node["deduplicate-downloads"].as<bool>();
+        }
+        if (options_node["download-cache-size"].IsDefined()
+            && options_node["download-cache-size"].IsScalar()) {
+            download_cache_size =
+                options_node["download-cache-size"].as<uint64_t>() * 1024 * 1024;
+        }
+        if (options_node["mirror-failure-threshold"].IsDefined()
+            && options_node["mirror-failure-threshold"].IsScalar()) {
+            mirror_failure_threshold = options_node["mirror-failure-threshold"].as<std::size_t>();
+        }
+        if (options_node["mirror-cooldown"].IsDefined()
+            && options_node["mirror-cooldown"].IsScalar()) {
+            mirror_cooldown =
+                std::chrono::milliseconds(options_node["mirror-cooldown"].as<int64_t>());
+        }
         for (auto const& branch : options_node["sync-branches"].as<std::vector<std::string>>()) {
             for (auto const& repo : root_node["repositories"]) {
                 auto const& key = repo.first;
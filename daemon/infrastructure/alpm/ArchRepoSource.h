@@ -6,11 +6,15 @@
  */
 #pragma once
 
+#include "infrastructure/alpm/ExcludeMatcher.h"
+
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <optional>
 #include <parallel_hashmap/phmap.h>
 #include <string>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 namespace bxt::Infrastructure {
@@ -30,6 +34,20 @@ struct ArchRepoSource {
         };
 
         result.repo_url = get_if_defined("repo-url", result.repo_url);
+
+        // Downloads are spread over the mirrors, repo-url is one of them if
+        // it's set explicitly
+        if (node["repo-url"].IsDefined() || !node["mirrors"].IsDefined()) {
+            result.mirrors.push_back(result.repo_url);
+        }
+        for (auto const& mirror : get_if_defined("mirrors", std::vector<std::string> {})) {
+            if (std::ranges::find(result.mirrors, mirror) == result.mirrors.end()) {
+                result.mirrors.push_back(mirror);
+            }
+        }
+        if (!result.mirrors.empty()) {
+            result.repo_url = result.mirrors.front();
+        }
         result.repo_structure_template =
             get_if_defined("repo-structure-template", result.repo_structure_template);
         auto const exclude_list_path =
@@ -42,13 +60,18 @@ struct ArchRepoSource {
             }
             file.close();
         }
+        result.exclude_matcher = ExcludeMatcher(result.exclude_list);
 
         return result;
     };
 
     std::string repo_url = "cloudflaremirrors.com";
+    // Hosts serving the same repository, repo_url is the first one
+    std::vector<std::string> mirrors;
     std::string repo_structure_template = "/archlinux/{repository}/os/{architecture}";
     phmap::parallel_flat_hash_set<std::string> exclude_list;
+    // The exclude list compiled once, used to check the package names
+    ExcludeMatcher exclude_matcher;
 
     std::optional<std::string> repo_name;
 };
@@ -12,28 +12,38 @@
 #include "core/domain/entities/Package.h"
 #include "core/domain/enums/PoolLocation.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
+#include "infrastructure/alpm/PartialDownload.h"
 #include "utilities/alpmdb/Desc.h"
 #include "utilities/base64.h"
 #include "utilities/Error.h"
-#include "utilities/hash_from_file.h"
 #include "utilities/libarchive/Reader.h"
 #include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <coro/sync_wait.hpp>
 #include <coro/thread_pool.hpp>
 #include <coro/when_all.hpp>
+#include <cstdint>
 #include <expected>
+#include <filesystem>
+#include <fmt/ranges.h>
+#include <fstream>
 #include <httplib.h>
 #include <ios>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <nonstd/scope.hpp>
-#include <openssl/sha.h>
 #include <optional>
+#include <random>
 #include <ranges>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace bxt::Infrastructure {
@@ -45,33 +55,42 @@ coro::task<SyncService::Result<void>> ArchRepoSyncService::sync(PackageSectionDT
     co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
         std::make_shared<SyncStarted>());
 
-    auto uow = co_await m_uow_factory(true);
-
-    auto all_packages = co_await sync_section(section);
-    if (!all_packages.has_value()) {
-        co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
-            std::make_shared<SyncFinished>(std::move(*all_packages),
-                                           std::vector<bxt::Core::Domain::Package::TId> {},
-                                           context.user_name));
+    // Packages that were saved before a failure stay saved, so they are
+    // reported either way
+    std::vector<Package> synced_packages;
+    auto synced = co_await sync_section(section, synced_packages);
 
-        co_return std::unexpected(all_packages.error());
+    if (m_options.deduplicate_downloads) {
+        logi("Sync: {} MiB were linked from other sections instead of downloaded",
+             m_content.take_bytes_saved() / (1024 * 1024));
     }
-    co_await uow->commit_async();
+
+    trim_download_cache();
 
     co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
-        std::move(*all_packages), std::vector<bxt::Core::Domain::Package::TId> {},
+        std::move(synced_packages), std::vector<bxt::Core::Domain::Package::TId> {},
         context.user_name));
 
+    if (!synced.has_value()) {
+        co_return std::unexpected(synced.error());
+    }
+
     co_return {};
 }
 
 coro::task<SyncService::Result<void>> ArchRepoSyncService::sync_all(RequestContext const context) {
     using namespace Core::Application::Events;
 
-    auto tasks =
-        m_options.sources
-        | std::views::transform([this](auto const& src) { return sync_section(src.first); })
-        | std::ranges::to<std::vector>();
+    // Every section saves its packages as they come, the lists only keep
+    // what is needed to report them
+    std::vector<std::vector<Package>> synced_packages(m_options.sources.size());
+
+    std::vector<coro::task<SyncService::Result<void>>> tasks;
+    tasks.reserve(m_options.sources.size());
+
+    for (std::size_t index = 0; auto const& [section, source] : m_options.sources) {
+        tasks.emplace_back(sync_section(section, synced_packages[index++]));
+    }
 
     auto guard = nonstd::make_scope_exit([this]() {
         coro::sync_wait(m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
@@ -81,121 +100,478 @@ coro::task<SyncService::Result<void>> ArchRepoSyncService::sync_all(RequestConte
     co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
         std::make_shared<SyncStarted>());
 
-    auto package_lists = co_await coro::when_all(std::move(tasks));
+    auto results = co_await coro::when_all(std::move(tasks));
 
-    if (package_lists.empty()) {
-        logi("No packages to sync");
-        co_return {};
+    std::optional<SyncError> failure;
+    std::size_t failed_sections = 0;
+
+    for (std::size_t index = 0; auto const& [section, source] : m_options.sources) {
+        auto& synced = results[index].return_value();
+
+        if (!synced.has_value()) {
+            loge("Failed to sync {}, {} of its packages are saved: {}", bxt::to_string(section),
+                 synced_packages[index].size(), synced.error().what());
+
+            ++failed_sections;
+            if (!failure) {
+                failure = synced.error();
+            }
+        }
+        ++index;
+    }
+
+    std::vector<Package> all_packages;
+    for (auto& package_list : synced_packages) {
+        all_packages.insert(all_packages.end(), std::make_move_iterator(package_list.begin()),
+                            std::make_move_iterator(package_list.end()));
+    }
+
+    if (failed_sections == 0) {
+        logi("Saved {} packages to database", all_packages.size());
+    } else {
+        logw("Saved {} packages to database, {} of {} sections failed", all_packages.size(),
+             failed_sections, m_options.sources.size());
+    }
+
+    auto const client_stats = m_clients.stats();
+    logi("Sync: {} requests reused a connection, {} needed a handshake",
+         client_stats.reused, client_stats.handshakes);
+
+    auto const download_stats = m_downloads.stats();
+    logi("Sync: {} downloads, {} MiB in total, at most {} at once",
+         download_stats.downloads, download_stats.bytes / (1024 * 1024),
+         download_stats.peak_in_flight);
+
+    auto const save_stats = this->save_stats();
+    logi("Sync: {} saves waited {}ms (at most {}ms) for the write transaction and held it for "
+         "{}ms (at most {}ms)",
+         save_stats.saves, save_stats.lock_wait.count(), save_stats.max_lock_wait.count(),
+         save_stats.lock_hold.count(), save_stats.max_lock_hold.count());
+
+    auto const event_stats = m_dispatcher.stats();
+    logi("Event bus: {} events delivered, {} queued, last took {}us, at most {}us",
+         event_stats.dispatched, event_stats.queue_depth, event_stats.last_latency.count(),
+         event_stats.max_latency.count());
+
+    if (m_options.deduplicate_downloads) {
+        logi("Sync: {} MiB were linked from other sections instead of downloaded",
+             m_content.take_bytes_saved() / (1024 * 1024));
+
+        // Blobs whose packages left the pool are not needed anymore
+        auto const collected = m_content.collect_garbage();
+        logd("Sync: removed {} unreferenced blobs", collected);
+    }
+
+    trim_download_cache();
+
+    // Entries of files that were moved to the pool or evicted are dropped
+    m_hashes.compact();
+
+    guard.release();
+    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
+        std::move(all_packages), std::vector<bxt::Core::Domain::Package::TId> {},
+        context.user_name));
+
+    if (failure) {
+        co_return std::unexpected(std::move(*failure));
     }
 
-    auto& all_packages = package_lists[0].return_value();
-    if (!all_packages.has_value()) {
-        loge("Failed to sync packages: {}", all_packages.error().what());
-        co_return std::unexpected(all_packages.error());
+    co_return {};
+}
+
+coro::task<std::vector<SyncPlanDTO>> ArchRepoSyncService::plan_all() {
+    std::vector<coro::task<SyncService::Result<SyncPlanDTO>>> tasks;
+    tasks.reserve(m_options.sources.size());
+
+    for (auto const& [section, source] : m_options.sources) {
+        tasks.emplace_back(plan_section(section));
     }
 
-    for (auto it = package_lists.begin() + 1; it != package_lists.end(); ++it) {
-        auto& package_list = it->return_value();
+    auto results = co_await coro::when_all(std::move(tasks));
+
+    std::vector<SyncPlanDTO> plans;
+    plans.reserve(results.size());
+
+    for (std::size_t index = 0; auto const& [section, source] : m_options.sources) {
+        auto& plan = results[index++].return_value();
 
-        if (!package_list.has_value()) {
-            loge("Failed to sync packages: {}", all_packages.error().what());
+        if (!plan.has_value()) {
+            logw("Can't plan the sync of {}: {}", bxt::to_string(section), plan.error().what());
+            plans.emplace_back(SyncPlanDTO {.section = section, .error = plan.error().what()});
+            continue;
+        }
+
+        plans.emplace_back(std::move(*plan));
+    }
+
+    co_return plans;
+}
 
-            co_return std::unexpected(package_list.error());
+coro::task<SyncService::Result<SyncPlanDTO>>
+    ArchRepoSyncService::plan_section(PackageSectionDTO const section) {
+    auto index = cached_index(section);
+    if (!index) {
+        auto fetched = co_await fetch_index(section);
+        if (!fetched.has_value()) {
+            co_return bxt::make_error_with_source<SyncError>(std::move(fetched.error()),
+                                                             SyncError::NetworkError);
         }
+        index = std::move(*fetched);
+    }
+
+    // A read transaction only, the same bulk lookup the sync diffs against
+    auto uow = co_await m_uow_factory();
+    auto const section_entity = SectionDTOMapper::to_entity(section);
 
-        all_packages->insert(all_packages->end(), std::make_move_iterator(package_list->begin()),
-                             std::make_move_iterator(package_list->end()));
+    auto local_versions =
+        co_await m_package_repository.find_versions_by_section_async(section_entity, uow);
+    if (!local_versions.has_value()) {
+        co_return bxt::make_error_with_source<SyncError>(std::move(local_versions.error()),
+                                                         SyncError::RepositoryError);
     }
 
-    logi("Downloaded {} packages, saving to database...", all_packages->size());
+    SyncPlanDTO plan {.section = section};
+
+    auto const download_directory = m_options.download_path / bxt::to_string(section);
+    phmap::flat_hash_set<std::string> remote_names;
+
+    for (auto const& package_info : index->packages) {
+        remote_names.insert(package_info.name);
+
+        if (is_excluded(section, package_info.name)) {
+            continue;
+        }
+
+        auto const local_version = local_versions->find(package_info.name);
+        if (local_version != local_versions->end()
+            && !(local_version->second < package_info.version)) {
+            continue;
+        }
+
+        SyncPlanEntryDTO entry {.name = package_info.name,
+                                .remote_version = package_info.version.string(),
+                                .size = package_info.size};
+
+        plan.total_size += package_info.size;
+
+        auto const cached =
+            m_hashes.sha256sum(download_directory / package_info.filename) == package_info.hash
+            || (m_options.deduplicate_downloads && m_content.contains(package_info.hash));
+        if (!cached) {
+            plan.download_size += package_info.size;
+        }
+
+        if (local_version == local_versions->end()) {
+            plan.to_add.emplace_back(std::move(entry));
+        } else {
+            entry.local_version = local_version->second.string();
+            plan.to_update.emplace_back(std::move(entry));
+        }
+    }
+
+    // Only the packages that came from a sync count as gone upstream, the
+    // ones that are only in the overlay were never there
+    for (auto const& [name, version] : *local_versions) {
+        if (remote_names.contains(name)) {
+            continue;
+        }
+
+        auto package =
+            co_await m_package_repository.find_by_section_async(section_entity, name, uow);
+        if (!package.has_value()) {
+            continue;
+        }
+
+        auto const pool_entries = package->pool_entries();
+        auto const sync_entry = pool_entries.find(Core::Domain::PoolLocation::Sync);
+        if (sync_entry == pool_entries.end()) {
+            continue;
+        }
+
+        std::error_code ec;
+        auto const size = std::filesystem::file_size(sync_entry->second.file_path(), ec);
+
+        plan.local_only.emplace_back(
+            SyncPlanEntryDTO {.name = name,
+                              .local_version = sync_entry->second.version().string(),
+                              .size = ec ? 0 : size});
+    }
+
+    co_return plan;
+}
+
+coro::task<SyncService::Result<void>>
+    ArchRepoSyncService::save_packages(std::vector<Package> const& packages) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    using std::chrono::steady_clock;
+
+    auto const requested_at = steady_clock::now();
 
     auto uow = co_await m_uow_factory(true);
 
-    auto saved = co_await m_package_repository.save_async(*all_packages, uow);
+    auto const acquired_at = steady_clock::now();
+
+    auto saved = co_await m_package_repository.save_async(packages, uow);
     if (!saved.has_value()) {
         loge("Failed to save packages: {}", saved.error().what());
+        co_await uow->rollback_async();
         co_return bxt::make_error_with_source<SyncError>(std::move(saved.error()),
                                                          SyncError::RepositoryError);
     }
 
     auto commit_ok = co_await uow->commit_async();
-
     if (!commit_ok.has_value()) {
-        loge("Failed to save packages: {}", saved.error().what());
+        loge("Failed to commit packages: {}", commit_ok.error().what());
         co_return bxt::make_error_with_source<SyncError>(std::move(commit_ok.error()),
                                                          SyncError::RepositoryError);
     }
 
-    logi("Saved {} packages to database", all_packages->size());
+    auto const released_at = steady_clock::now();
+
+    auto const wait = duration_cast<milliseconds>(acquired_at - requested_at);
+    auto const hold = duration_cast<milliseconds>(released_at - acquired_at);
+
+    {
+        std::scoped_lock const lock(m_save_stats_mutex);
+
+        ++m_save_stats.saves;
+        m_save_stats.lock_wait += wait;
+        m_save_stats.max_lock_wait = std::max(m_save_stats.max_lock_wait, wait);
+        m_save_stats.lock_hold += hold;
+        m_save_stats.max_lock_hold = std::max(m_save_stats.max_lock_hold, hold);
+    }
+
+    logd("Sync: waited {}ms for the write transaction, held it for {}ms to save {} packages",
+         wait.count(), hold.count(), packages.size());
 
-    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
-        std::move(*all_packages), std::vector<bxt::Core::Domain::Package::TId> {},
-        context.user_name));
-    guard.release();
     co_return {};
 }
 
-coro::task<SyncService::Result<std::vector<Package>>>
-    ArchRepoSyncService::sync_section(PackageSectionDTO const section) {
+std::chrono::milliseconds ArchRepoSyncService::retry_delay(int attempt) const {
+    thread_local std::mt19937 random_engine {std::random_device {}()};
+
+    // Exponential backoff capped at the maximum delay. Half of the delay is
+    // random so the downloads that failed together don't retry together.
+    auto const exponent = std::min(attempt, 16);
+    auto const delay = std::min(m_options.retry_base_delay * (int64_t {1} << exponent),
+                                m_options.retry_max_delay);
+
+    std::uniform_int_distribution<int64_t> jitter(0, delay.count() / 2);
+
+    return delay - std::chrono::milliseconds(jitter(random_engine));
+}
+
+coro::task<ArchRepoSyncService::Result<Package>>
+    ArchRepoSyncService::fetch_package(PackageSectionDTO section, PackageInfo pkginfo) {
+    for (int attempt = 1;; ++attempt) {
+        auto package = co_await download_package(section, pkginfo);
+
+        if (package.has_value() || attempt >= m_options.download_retries) {
+            co_return package;
+        }
+
+        auto const delay = retry_delay(attempt - 1);
+
+        logw("Download of {} has failed. The reason is \"{}\". Retrying in {}ms, attempt {}",
+             pkginfo.filename, package.error().what(), delay.count(), attempt + 1);
+
+        co_await tp->yield_for(delay);
+    }
+}
+
+namespace {
+    // The saved package as far as the sync events need it: the pool entries
+    // without their descs, which make up most of a parsed package
+    Package without_desc(Package const& package) {
+        Package result(package.section(), package.name(), package.is_any_arch());
+
+        for (auto const& [location, entry] : package.pool_entries()) {
+            result.pool_entries().emplace(
+                location, Core::Domain::PackagePoolEntry(entry.file_path(), entry.signature_path(),
+                                                         {}, entry.version()));
+        }
+
+        return result;
+    }
+} // namespace
+
+coro::task<SyncService::Result<void>>
+    ArchRepoSyncService::sync_section(PackageSectionDTO const section,
+                                      std::vector<Package>& synced_packages) {
+    using namespace Core::Application::Events;
+
     if (!m_options.sources.contains(section)) {
         co_return {};
     }
-    constexpr int max_retries = 5;
-    std::vector<Package> packages;
 
-    for (int attempt = 0; attempt < max_retries; ++attempt) {
-        auto remote_packages = co_await get_available_packages(section);
+    Result<AvailablePackages> remote_packages;
 
-        if (!remote_packages.has_value()) {
-            if (attempt == max_retries - 1) {
-                co_return bxt::make_error_with_source<SyncError>(std::move(remote_packages.error()),
-                                                                 SyncError::NetworkError);
-            }
-            continue;
+    for (int attempt = 1;; ++attempt) {
+        remote_packages = co_await get_available_packages(section);
+
+        if (remote_packages.has_value()) {
+            break;
+        }
+
+        if (attempt >= m_options.download_retries) {
+            co_return bxt::make_error_with_source<SyncError>(std::move(remote_packages.error()),
+                                                             SyncError::NetworkError);
         }
 
-        auto task = [this, section](PackageInfo const pkginfo) -> coro::task<Result<Package>> {
-            co_return co_await download_package(section, pkginfo.filename, pkginfo.hash,
-                                                pkginfo.signature);
-        };
+        auto const delay = retry_delay(attempt - 1);
+
+        logw("Can't get the packages of {}: {}. Retrying in {}ms", bxt::to_string(section),
+             remote_packages.error().what(), delay.count());
+
+        co_await tp->yield_for(delay);
+    }
+
+    // Packages verified by an earlier sync that didn't finish are found in
+    // the hash cache, so they are neither downloaded nor hashed again.
+
+    SectionPipeline pipeline {.section = section,
+                              .total = remote_packages->packages.size(),
+                              .synced_packages = synced_packages};
+
+    // Not a coroutine itself: fetch_and_save copies its arguments into its
+    // own frame, so nothing refers to the lambda once the task is created
+    auto const task = [this, &pipeline](PackageInfo const& pkginfo) {
+        return fetch_and_save(pkginfo, pipeline);
+    };
+
+    // All downloads are queued at once, the download scheduler decides how
+    // many run. Packages are saved while the others are still downloading.
+    auto tasks = remote_packages->packages | std::views::transform(task)
+                 | std::ranges::to<std::vector>();
+
+    co_await coro::when_all(std::move(tasks));
+
+    // Whatever is left in the buffer once the downloads are done
+    co_await save_buffered(pipeline, 1);
+
+    // Chunks that failed to save get one more try
+    if (!pipeline.unsaved.empty()) {
+        pipeline.buffer = std::exchange(pipeline.unsaved, {});
+        pipeline.save_failure.reset();
+
+        co_await save_buffered(pipeline, 1);
+    }
+
+    if (!pipeline.unsaved.empty()) {
+        std::vector<std::string> names;
+        names.reserve(pipeline.unsaved.size());
+        for (auto const& package : pipeline.unsaved) {
+            names.emplace_back(package.name());
+        }
+
+        loge("{} packages of {} are not saved: {}", names.size(), bxt::to_string(section),
+             fmt::join(names, ", "));
+
+        pipeline.save_failure->message +=
+            fmt::format(" ({} packages are not saved: {})", names.size(), fmt::join(names, ", "));
+    }
+
+    if (pipeline.save_failure || pipeline.download_failure) {
+        logi("{} of {} packages of {} are saved, the rest will be retried by the next sync",
+             synced_packages.size(), pipeline.total, bxt::to_string(section));
+    }
+
+    if (pipeline.save_failure) {
+        co_return std::unexpected(std::move(*pipeline.save_failure));
+    }
+
+    if (pipeline.download_failure) {
+        co_return bxt::make_error_with_source<SyncError>(std::move(*pipeline.download_failure),
+                                                         SyncError::NetworkError);
+    }
+
+    mark_synced(section, remote_packages->index);
 
-        auto tasks =
-            *remote_packages | std::views::transform(task) | std::ranges::to<std::vector>();
+    co_return {};
+}
+
+coro::task<void> ArchRepoSyncService::fetch_and_save(PackageInfo pkginfo,
+                                                    SectionPipeline& pipeline) {
+    auto package = co_await fetch_package(pipeline.section, std::move(pkginfo));
 
-        auto const package_results = co_await coro::when_all(std::move(tasks));
-        bool all_downloads_successful = true;
-        packages.clear();
-        packages.reserve(package_results.size());
+    {
+        std::scoped_lock const lock(pipeline.mutex);
 
-        for (auto const& package_result : package_results) {
-            auto& package = package_result.return_value();
+        if (!package.has_value()) {
+            loge("Download of {} has failed after {} attempts. The reason is \"{}\"",
+                 package.error().package_filename, m_options.download_retries,
+                 package.error().what());
 
-            if (!package.has_value()) {
-                loge("Download of {} has failed. The reason is \"{}\". "
-                     "Retrying...",
-                     package.error().package_filename, package.error().what());
-                all_downloads_successful = false;
-                break;
+            if (!pipeline.download_failure) {
+                pipeline.download_failure = std::move(package.error());
             }
+            co_return;
+        }
+
+        pipeline.buffer.emplace_back(std::move(*package));
 
-            packages.emplace_back(std::move(*package));
+        if (pipeline.saving || pipeline.buffer.size() < m_options.sync_chunk_size) {
+            co_return;
         }
+        pipeline.saving = true;
+    }
 
-        if (all_downloads_successful) {
-            break;
+    co_await save_buffered(pipeline, m_options.sync_chunk_size);
+}
+
+coro::task<void> ArchRepoSyncService::save_buffered(SectionPipeline& pipeline,
+                                                   std::size_t min_size) {
+    using namespace Core::Application::Events;
+
+    // Packages that finish during a save are saved by the next round
+    for (;;) {
+        std::vector<Package> packages;
+        {
+            std::scoped_lock const lock(pipeline.mutex);
+
+            if (pipeline.buffer.empty() || pipeline.buffer.size() < min_size) {
+                pipeline.saving = false;
+                co_return;
+            }
+            packages = std::exchange(pipeline.buffer, {});
         }
 
-        if (attempt == max_retries - 1) {
-            loge("Max retries reached. Some package downloads failed.");
-            co_return bxt::make_error<SyncError>(SyncError::NetworkError);
+        auto saved = co_await save_packages(packages);
+        if (!saved.has_value()) {
+            logw("Can't save {} packages of {}: {}", packages.size(),
+                 bxt::to_string(pipeline.section), saved.error().what());
+
+            std::scoped_lock const lock(pipeline.mutex);
+
+            if (!pipeline.save_failure) {
+                pipeline.save_failure = std::move(saved.error());
+            }
+            pipeline.unsaved.insert(pipeline.unsaved.end(),
+                                    std::make_move_iterator(packages.begin()),
+                                    std::make_move_iterator(packages.end()));
+            continue;
         }
 
-        logi("Retrying to sync packages, attempt {}", attempt + 1);
-    }
+        // The saved files were moved to the pool
+        for (auto const& package : packages) {
+            m_cache.forget(package.filepath());
+            pipeline.synced_packages.emplace_back(without_desc(package));
+        }
 
-    co_return packages;
+        co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
+            std::make_shared<SyncProgress>(bxt::to_string(pipeline.section),
+                                           pipeline.synced_packages.size(), pipeline.total));
+    }
 }
 
+namespace {
+    // A resumed download is complete with 206 Partial Content as well
+    bool is_successful(httplib::Response const& response) {
+        return response.status == 200 || response.status == 206;
+    }
+} // namespace
+
 std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
     auto contents = entry.read_all();
 
@@ -239,15 +615,165 @@ std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
         signature = bxt::Utilities::b64_decode(*signature);
     }
 
+    // The size is only needed to plan syncs, so it's optional
+    uint64_t size = 0;
+    if (auto const csize = desc.get("CSIZE"); csize.has_value()) {
+        std::from_chars(csize->data(), csize->data() + csize->size(), size);
+    }
+
     return ArchRepoSyncService::PackageInfo {.name = *name,
                                              .filename = *filename,
                                              .version = *version,
                                              .hash = *hash,
-                                             .signature = signature};
+                                             .signature = signature,
+                                             .desc = std::move(desc.desc),
+                                             .size = size};
 }
-coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageInfo>>>
-    ArchRepoSyncService::get_available_packages(PackageSectionDTO const section) {
-    std::vector<PackageInfo> result;
+ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageInfo>>
+    ArchRepoSyncService::read_index(std::string const& path, Archive::Reader& reader) const {
+    std::vector<PackageInfo> packages;
+
+    for (auto& [header, entry] : reader) {
+        std::string pname = archive_entry_pathname(*header);
+
+        if (!pname.ends_with("/desc")) {
+            continue;
+        }
+
+        auto parsed_package_info = parse_descfile(entry);
+
+        if (!parsed_package_info.has_value()) {
+            return bxt::make_error<DownloadError>(
+                "Unknown", fmt::format("Cannot parse descfile {}", pname));
+        }
+
+        packages.emplace_back(std::move(*parsed_package_info));
+    }
+
+    return packages;
+}
+
+ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageInfo>>
+    ArchRepoSyncService::parse_stream(std::string const& path,
+                                      Utilities::Http::ChunkPipe& pipe) const {
+    Archive::Reader reader;
+
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+
+    auto open_ok = reader.open_callback([&pipe](void const** buffer) -> la_ssize_t {
+        auto const chunk = pipe.read();
+        *buffer = chunk.data();
+        return static_cast<la_ssize_t>(chunk.size());
+    });
+
+    if (!open_ok.has_value()) {
+        return bxt::make_error_with_source<DownloadError>(std::move(open_ok.error()), path,
+                                                          "The archive cannot be opened");
+    }
+
+    return read_index(path, reader);
+}
+
+std::filesystem::path ArchRepoSyncService::index_path(PackageSectionDTO const& section) const {
+    return m_options.download_path / bxt::to_string(section) / ".index.db";
+}
+
+ArchRepoSyncService::SectionIndexPtr
+    ArchRepoSyncService::cached_index(PackageSectionDTO const& section) {
+    {
+        std::scoped_lock const lock(m_indexes_mutex);
+        if (auto const cached = m_indexes.find(section); cached != m_indexes.end()) {
+            return cached->second;
+        }
+    }
+
+    // After a restart the index stored by the last fetch is parsed once, so
+    // the first fetch can already be conditional
+    auto const path = index_path(section);
+
+    std::ifstream validators_file(path.string() + ".meta");
+    if (!validators_file.is_open()) {
+        return nullptr;
+    }
+
+    SectionIndex index;
+    std::getline(validators_file, index.etag);
+    std::getline(validators_file, index.last_modified);
+
+    Archive::Reader reader;
+
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+
+    if (!reader.open_filename(path).has_value()) {
+        return nullptr;
+    }
+
+    auto packages = read_index(path.string(), reader);
+    if (!packages.has_value()) {
+        logw("The stored index {} can't be parsed, ignoring it", path.string());
+        return nullptr;
+    }
+    index.packages = std::move(*packages);
+
+    auto loaded = std::make_shared<SectionIndex const>(std::move(index));
+
+    std::scoped_lock const lock(m_indexes_mutex);
+    m_indexes.insert_or_assign(section, loaded);
+
+    return loaded;
+}
+
+void ArchRepoSyncService::store_index(PackageSectionDTO const& section,
+                                      SectionIndexPtr index,
+                                      std::filesystem::path const& body_path) {
+    {
+        std::scoped_lock const lock(m_indexes_mutex);
+        m_indexes.insert_or_assign(section, index);
+    }
+
+    if (body_path.empty()) {
+        return;
+    }
+
+    auto const path = index_path(section);
+    auto const validators_path = path.string() + ".meta";
+
+    std::error_code ec;
+
+    // Validators that don't belong to the stored body would make the next
+    // fetch skip a .db that was never parsed, so they go away first
+    std::filesystem::remove(validators_path, ec);
+
+    // Without validators a conditional request is impossible, so there is
+    // no point in keeping the body
+    if (index->etag.empty() && index->last_modified.empty()) {
+        std::filesystem::remove(body_path, ec);
+        return;
+    }
+
+    std::filesystem::rename(body_path, path, ec);
+    if (ec) {
+        logw("Can't store the index of {}: {}", bxt::to_string(section), ec.message());
+        std::filesystem::remove(body_path, ec);
+        return;
+    }
+
+    std::ofstream validators_file(validators_path, std::ios::trunc);
+    validators_file << index->etag << '\n' << index->last_modified << '\n';
+
+    if (!validators_file.flush()) {
+        logw("Can't store the index of {}", bxt::to_string(section));
+        validators_file.close();
+        std::filesystem::remove(validators_path, ec);
+    }
+}
+
+coro::task<ArchRepoSyncService::Result<ArchRepoSyncService::SectionIndexPtr>>
+    ArchRepoSyncService::fetch_index(PackageSectionDTO const section) {
+    // Data of the .db buffered between the download and the parser
+    constexpr std::size_t stream_buffer_size = 1024 * 1024;
 
     auto const repository_name = m_options.sources[section].repo_name.value_or(section.repository);
 
@@ -258,74 +784,213 @@ coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageI
                                   fmt::arg("repository", repository_name),
                                   fmt::arg("architecture", section.architecture));
 
-    auto download_result = co_await download_file(m_options.sources[section].repo_url, path);
+    auto cached = cached_index(section);
+
+    httplib::Headers headers;
+    if (cached) {
+        if (!cached->etag.empty()) {
+            headers.emplace("If-None-Match", cached->etag);
+        }
+        if (!cached->last_modified.empty()) {
+            headers.emplace("If-Modified-Since", cached->last_modified);
+        }
+    }
+
+    auto const body_path = std::filesystem::path(index_path(section).string() + ".part");
+
+    std::error_code ec;
+    std::filesystem::create_directories(body_path.parent_path(), ec);
+
+    // The .db is parsed on its own thread while it's being received, and
+    // written to the disk for the next start. The whole body is never held
+    // in memory.
+    Utilities::Http::ChunkPipe pipe(stream_buffer_size);
+    std::ofstream body_file;
+    std::optional<Result<std::vector<PackageInfo>>> parsed;
+    std::atomic<bool> parse_failed = false;
+    std::jthread parser;
+
+    if (m_options.sources[section].mirrors.size() > 1) {
+        co_await probe_mirrors(section, path);
+    }
+
+    auto download_result = co_await stream_file(
+        section, path, headers,
+        [&](httplib::Response const& head) {
+            if (head.status != 200) {
+                return true;
+            }
+
+            body_file.open(body_path, std::ios::binary | std::ios::trunc);
+            parser = std::jthread([&]() {
+                parsed = parse_stream(path, pipe);
+                parse_failed = !parsed->has_value();
+                pipe.close_read();
+            });
+
+            return true;
+        },
+        [&](char const* data, size_t data_length) {
+            if (!parser.joinable()) {
+                return true;
+            }
+
+            body_file.write(data, static_cast<std::streamsize>(data_length));
+
+            // The parser stops at the end of the archive, anything after it
+            // is padding that can be dropped
+            return pipe.write(data, data_length) || !parse_failed;
+        });
+
+    pipe.close_write();
+    if (parser.joinable()) {
+        parser.join();
+    }
+    body_file.close();
+
+    auto const fail = [&](auto error) {
+        std::filesystem::remove(body_path, ec);
+        return error;
+    };
 
     if (!download_result.has_value()) {
-        co_return bxt::make_error<DownloadError>(path, "Can't download the database");
+        co_return fail(bxt::make_error<DownloadError>(path, "Can't download the database"));
     }
     if (!(*download_result)) {
-        co_return bxt::make_error<DownloadError>(path,
-                                                 httplib::to_string(download_result->error()));
+        co_return fail(
+            bxt::make_error<DownloadError>(path, httplib::to_string(download_result->error())));
     }
 
-    auto response = download_result->value();
+    auto const& response = download_result->value();
 
-    if (response.status != 200) {
-        co_return bxt::make_error<DownloadError>(path, "The response is non-200");
+    if (response.status == 304 && cached) {
+        logi("{} is not modified, using the cached index", path);
+        co_return cached;
     }
 
-    Archive::Reader reader;
+    if (response.status != 200 || !parsed.has_value()) {
+        co_return fail(bxt::make_error<DownloadError>(path, "The response is non-200"));
+    }
 
-    archive_read_support_filter_all(reader);
-    archive_read_support_format_all(reader);
+    if (!parsed->has_value()) {
+        co_return fail(std::unexpected(std::move(parsed->error())));
+    }
 
-    auto open_ok =
-        reader.open_memory(reinterpret_cast<uint8_t*>(response.body.data()), response.body.size());
+    auto index = std::make_shared<SectionIndex const>(
+        SectionIndex {.etag = response.get_header_value("ETag"),
+                      .last_modified = response.get_header_value("Last-Modified"),
+                      .packages = std::move(**parsed)});
 
-    if (!open_ok.has_value()) {
-        co_return bxt::make_error_with_source<DownloadError>(std::move(open_ok.error()), path,
-                                                             "The archive cannot be opened");
+    if (!body_file) {
+        logw("Can't write the index of {} to the disk", bxt::to_string(section));
+        std::filesystem::remove(body_path, ec);
+        store_index(section, index, {});
+    } else {
+        store_index(section, index, body_path);
     }
+
+    co_return index;
+}
+
+void ArchRepoSyncService::mark_synced(PackageSectionDTO const& section, SectionIndexPtr index) {
+    std::scoped_lock const lock(m_indexes_mutex);
+    m_synced_indexes.insert_or_assign(section, std::move(index));
+}
+
+bool ArchRepoSyncService::is_synced(PackageSectionDTO const& section,
+                                    SectionIndexPtr const& index) {
+    std::scoped_lock const lock(m_indexes_mutex);
+
+    // A modified .db is parsed into a new index, so only a 304 gives back
+    // the index that was synced
+    auto const synced = m_synced_indexes.find(section);
+    return synced != m_synced_indexes.end() && synced->second == index;
+}
+
+coro::task<ArchRepoSyncService::Result<ArchRepoSyncService::AvailablePackages>>
+    ArchRepoSyncService::get_available_packages(PackageSectionDTO const section) {
+    auto index = co_await fetch_index(section);
+    if (!index.has_value()) {
+        co_return std::unexpected(std::move(index.error()));
+    }
+
+    if (is_synced(section, *index)) {
+        logi("{} was fully synced since its .db last changed, nothing to do",
+             bxt::to_string(section));
+        co_return AvailablePackages {.index = std::move(*index)};
+    }
+
+    // The local versions are read in one pass, the diff is then a plain
+    // join of the two maps
     auto uow = co_await m_uow_factory();
-    for (auto& [header, entry] : reader) {
-        std::string pname = archive_entry_pathname(*header);
+    auto local_versions = co_await m_package_repository.find_versions_by_section_async(
+        SectionDTOMapper::to_entity(section), uow);
 
-        if (!pname.ends_with("/desc")) {
+    if (!local_versions.has_value()) {
+        co_return bxt::make_error_with_source<DownloadError>(
+            std::move(local_versions.error()), bxt::to_string(section),
+            "Can't read the packages of the section");
+    }
+
+    AvailablePackages result {.index = *index};
+
+    for (auto const& package_info : (*index)->packages) {
+        if (is_excluded(section, package_info.name)) {
+            logi("Package {} is excluded. Skipping.", package_info.name);
             continue;
         }
 
-        auto parsed_package_info = parse_descfile(entry);
+        auto const local_version = local_versions->find(package_info.name);
+        if (local_version == local_versions->end()
+            || local_version->second < package_info.version) {
+            result.packages.emplace_back(package_info);
+        }
+    }
+    co_return result;
+}
 
-        if (!parsed_package_info.has_value()) {
-            co_return bxt::make_error<DownloadError>(
-                "Unknown", fmt::format("Cannot parse descfile {}", pname));
+namespace {
+    // Builds a synced package from its desc in the upstream database. It has the
+    // same fields DescFormatter would produce from the package file, only the
+    // signature may be missing if the database doesn't carry it.
+    Package package_from_desc(PackageSectionDTO const& section,
+                              ArchRepoSyncService::PackageInfo const& pkginfo,
+                              std::filesystem::path const& filepath) {
+        std::optional<std::filesystem::path> signature_path;
+        if (auto const deduced_path = fmt::format("{}.sig", filepath.string());
+            std::filesystem::exists(deduced_path)) {
+            signature_path = deduced_path;
         }
 
-        auto const& [name, filename, version, hash, signature] = *parsed_package_info;
+        auto desc = pkginfo.desc;
 
-        if (is_excluded(section, name)) {
-            logi("Package {} is excluded. Skipping.", name);
-            continue;
-        }
+        if (!pkginfo.signature.has_value() && signature_path.has_value()) {
+            std::ifstream signature_file(*signature_path, std::ios::binary);
+            std::string const signature_data {std::istreambuf_iterator<char>(signature_file),
+                                              std::istreambuf_iterator<char>()};
 
-        auto const existing_package = co_await m_package_repository.find_by_section_async(
-            SectionDTOMapper::to_entity(section), name, uow);
-        if (existing_package.has_value()) {
-            if (existing_package->version() < version) {
-                result.emplace_back(std::move(*parsed_package_info));
+            if (!signature_data.empty()) {
+                desc += fmt::format("%PGPSIG%\n{}\n\n", bxt::Utilities::b64_encode(signature_data));
             }
-        } else {
-            result.emplace_back(std::move(*parsed_package_info));
         }
+
+        Package result(SectionDTOMapper::to_entity(section), pkginfo.name, false);
+        result.pool_entries().emplace(
+            Core::Domain::PoolLocation::Sync,
+            Core::Domain::PackagePoolEntry(filepath, signature_path,
+                                           Utilities::AlpmDb::Desc {.desc = std::move(desc)},
+                                           pkginfo.version));
+
+        return result;
     }
-    co_return result;
-}
+} // namespace
 
 coro::task<ArchRepoSyncService::Result<Package>>
-    ArchRepoSyncService::download_package(PackageSectionDTO section,
-                                          std::string package_filename,
-                                          std::string sha256_hash,
-                                          std::optional<std::string> signature) {
+    ArchRepoSyncService::download_package(PackageSectionDTO section, PackageInfo pkginfo) {
+    auto const& package_filename = pkginfo.filename;
+    auto const& sha256_hash = pkginfo.hash;
+    auto const& signature = pkginfo.signature;
+
     auto const repository_name = m_options.sources[section].repo_name.value_or(section.repository);
 
     auto const path_format =
@@ -349,16 +1014,24 @@ coro::task<ArchRepoSyncService::Result<Package>>
     if (std::filesystem::exists(full_filename)) {
         logi("Found package file in local cache: {}, checking the hash... ", full_filename);
 
-        if (bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(full_filename) == sha256_hash) {
+        if (m_hashes.hash(full_filename) == sha256_hash) {
             logi("Hash is ok. Using local cache package file: {}", full_filename);
+            m_cache.record_hit(full_filename);
         } else {
             logw("Hash is wrong. Invalid package file: {}, removing it", full_filename);
             std::filesystem::remove(full_filename);
         }
     }
+    // Another section may have the same file already, e.g. another
+    // branch that syncs the same upstream repository
+    if (m_options.deduplicate_downloads && !std::filesystem::exists(full_filename)
+        && m_content.link_to(sha256_hash, full_filename)) {
+        logi("Package file {} is already downloaded for another section, linked it", full_filename);
+        m_hashes.store(full_filename, sha256_hash);
+        m_cache.record_hit(full_filename);
+    }
     if (!std::filesystem::exists(full_filename)) {
-        auto response =
-            co_await download_file(m_options.sources[section].repo_url, path, full_filename);
+        auto response = co_await download_file(section, path, full_filename, sha256_hash);
 
         if (!response.has_value()) {
             co_return bxt::make_error<DownloadError>(package_filename,
@@ -368,12 +1041,22 @@ coro::task<ArchRepoSyncService::Result<Package>>
             co_return bxt::make_error<DownloadError>(package_filename,
                                                      httplib::to_string(response->error()));
         }
+        if (!is_successful(**response)) {
+            co_return bxt::make_error<DownloadError>(
+                package_filename, fmt::format("The response is {}", (*response)->status));
+        }
+
+        m_cache.record_miss(full_filename);
+    }
+
+    if (m_options.deduplicate_downloads) {
+        m_content.add(sha256_hash, full_filename);
     }
+
     if (signature == std::nullopt) {
         logi("Signature was not found in downloaded database."
              "Trying to download it from the repository...");
-        auto response = co_await download_file(m_options.sources[section].repo_url, path + ".sig",
-                                               full_filename + ".sig");
+        auto response = co_await download_file(section, path + ".sig", full_filename + ".sig");
 
         if (!response.has_value()) {
             co_return bxt::make_error<DownloadError>(package_filename + ".sig",
@@ -383,6 +1066,10 @@ coro::task<ArchRepoSyncService::Result<Package>>
             co_return bxt::make_error<DownloadError>(package_filename + ".sig",
                                                      httplib::to_string(response->error()));
         }
+        if (!is_successful(**response)) {
+            co_return bxt::make_error<DownloadError>(
+                package_filename + ".sig", fmt::format("The response is {}", (*response)->status));
+        }
     } else {
         logi("Signature was found in downloaded database, writing it to file.");
         std::ofstream sig_file(full_filename + ".sig", std::ios::binary);
@@ -397,6 +1084,12 @@ coro::task<ArchRepoSyncService::Result<Package>>
         }
     }
 
+    // The file matches the SHA256 of the upstream desc, so the desc already
+    // describes it and the archive doesn't have to be read again
+    if (!m_options.paranoid_verify) {
+        co_return package_from_desc(section, pkginfo, full_filename);
+    }
+
     auto result = Package::from_file_path(SectionDTOMapper::to_entity(section),
                                           Core::Domain::PoolLocation::Sync, full_filename);
 
@@ -408,85 +1101,242 @@ coro::task<ArchRepoSyncService::Result<Package>>
     }
 }
 coro::task<std::optional<httplib::Result>>
-    ArchRepoSyncService::download_file(std::string url, std::string path, std::string filename) {
-    using namespace std::chrono_literals;
-    constexpr int retry_max = 5;
-    constexpr auto delay = 50ms;
+    ArchRepoSyncService::stream_file(PackageSectionDTO section,
+                                     std::string path,
+                                     httplib::Headers headers,
+                                     httplib::ResponseHandler response_handler,
+                                     httplib::ContentReceiver content_receiver) {
+    auto const url = m_mirrors.select(m_options.sources[section].mirrors);
+
+    auto permit = co_await m_downloads.acquire(bxt::to_string(section), url);
+
+    auto client = co_await get_client(url);
+    if (!client) {
+        loge("Failed to get client for URL: {}", url);
+        m_mirrors.record_failure(url);
+        co_return {};
+    }
 
-    int current_retry = 0;
+    uint64_t downloaded_bytes = 0;
 
-    std::optional<httplib::Result> response;
+    std::optional<httplib::Result> response =
+        client->Get(path, headers, std::move(response_handler),
+                    [&](char const* data, size_t data_length) {
+                        downloaded_bytes += data_length;
+                        return content_receiver(data, data_length);
+                    });
 
-    while (current_retry < retry_max) {
-        auto client = co_await get_client(url);
-        if (!client) {
-            loge("Failed to get client for URL: {}", url);
-            co_return {};
-        }
+    if (*response && is_successful(**response)) {
+        auto const elapsed = permit.elapsed();
+        auto const rate = permit.record(downloaded_bytes);
 
-        if (!filename.empty()) {
-            std::ofstream stream(filename, std::ios::binary);
-            if (!stream.is_open()) {
-                loge("Failed to open file: {}", filename);
-                co_return {};
+        logi("Successfully downloaded file: {} from {} ({} KiB in {}ms, {:.1f} KiB/s)", path,
+             url, downloaded_bytes / 1024,
+             std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), rate / 1024);
+        m_mirrors.record_success(url, rate);
+        co_return response;
+    }
+
+    if (*response && (*response)->status == 304) {
+        permit.record(0);
+        m_mirrors.record_success(url, 0);
+        co_return response;
+    }
+
+    // After a transport error or a cancelled transfer the connection is in
+    // an unknown state, so it's not given back to the pool
+    if (!*response) {
+        client.discard();
+    }
+
+    // A transfer cancelled by the receiver is not the mirror's fault, a
+    // missing file is: the mirror may be out of date
+    auto const mirror_failed = *response ? (*response)->status >= 500 || (*response)->status == 404
+                                         : response->error() != httplib::Error::Canceled;
+    if (mirror_failed) {
+        m_mirrors.record_failure(url);
+    }
+
+    // Retrying is up to the caller, with a backoff, and may go to another
+    // mirror
+    logw("Failed to download file: {} from {}", path, url);
+    co_return response;
+}
+
+coro::task<std::optional<httplib::Result>>
+    ArchRepoSyncService::download_file(PackageSectionDTO section,
+                                       std::string path,
+                                       std::string filename,
+                                       std::string sha256_hash) {
+    // Whatever an interrupted attempt already got is kept and only the rest
+    // is requested. The mirrors serve the same files, so it may be resumed
+    // from another mirror.
+    PartialDownload partial(filename, path, sha256_hash);
+
+    auto const offset = partial.resumable_size();
+
+    httplib::Headers headers;
+    if (offset > 0) {
+        logi("Resuming download of {} from {} KiB", path, offset / 1024);
+        headers.emplace("Range", fmt::format("bytes={}-", offset));
+    }
+
+    bool receiving = false;
+    bool write_failed = false;
+
+    auto response = co_await stream_file(
+        section, path, headers,
+        [&](httplib::Response const& head) {
+            if (head.status == 206 && offset > 0
+                && PartialDownload::content_range_start(head.get_header_value("Content-Range"))
+                       == offset) {
+                receiving = partial.begin(true);
+            } else if (head.status == 200) {
+                // The server ignored the range, so it starts over
+                receiving = partial.begin(false);
+            } else {
+                // The body of an error response is not written anywhere
+                return true;
             }
 
-            response = client->Get(path, [&](char const* data, size_t data_length) {
-                stream.write(data, static_cast<std::streamsize>(data_length));
-                return stream.good();
-            });
+            write_failed = !receiving;
+            return receiving;
+        },
+        [&](char const* data, size_t data_length) {
+            if (!receiving) {
+                return true;
+            }
+
+            write_failed = !partial.write(data, data_length);
+            return !write_failed;
+        });
+
+    if (write_failed) {
+        loge("Failed to write to file: {}", partial.part_path().string());
+        co_return {};
+    }
 
-            stream.close();
+    if (!response.has_value() || !*response) {
+        co_return response;
+    }
+
+    if (is_successful(**response)) {
+        if (!receiving) {
+            // A partial response that doesn't continue the partial file
+            logw("The server returned an unexpected range for {}", path);
+            partial.discard();
+            co_return {};
+        }
+        if (!partial.finish()) {
+            loge("Failed to move the downloaded file to {}", filename);
+            co_return {};
+        }
 
-            if (!stream) {
-                loge("Failed to write to file: {}", filename);
+        if (!sha256_hash.empty()) {
+            // A resumed file is only complete if it matches the hash as a whole
+            if (partial.received_sha256sum() != sha256_hash) {
+                loge("The hash of the downloaded {} doesn't match", filename);
+                std::error_code ec;
+                std::filesystem::remove(filename, ec);
                 co_return {};
             }
-        } else {
-            response = client->Get(path, httplib::Headers());
-        }
 
-        if (response && response->error() == httplib::Error::Success
-            && response->value().status == 200) {
-            logi("Successfully downloaded file: {}", path);
-            co_return response;
+            m_hashes.store(filename, sha256_hash);
         }
-
-        logw("Failed to download file: {}, retrying...", path);
-        co_await tp->yield_for(delay);
-        ++current_retry;
+    } else if ((*response)->status == 416) {
+        // The partial file can't be continued, the next attempt starts over
+        partial.discard();
     }
 
-    loge("Failed to download file: {} after {} retries", path, retry_max);
     co_return response;
 }
 
-bool ArchRepoSyncService::is_excluded(PackageSectionDTO const& section,
-                                      std::string const& package_name) const {
-    auto const& exclude_list = m_options.sources.at(section).exclude_list;
-    for (auto const& pattern : exclude_list) {
-        if (std::regex_match(package_name, std::regex(pattern))) {
-            return true;
+void ArchRepoSyncService::trim_download_cache() {
+    auto const evicted = m_cache.evict();
+
+    auto const stats = m_cache.stats();
+    logi("Download cache: {} MiB in {} files, {} hits, {} misses, {} evictions ({} this sync)",
+         stats.bytes / (1024 * 1024), stats.files, stats.hits, stats.misses, stats.evictions,
+         evicted);
+}
+
+coro::task<void> ArchRepoSyncService::probe_mirrors(PackageSectionDTO const section,
+                                                   std::string const path) {
+    // Every index fetch comes here, but a mirror is only probed again once
+    // the last measurement is a cooldown old. Between the probes the
+    // throughput of the downloads keeps the measurements up to date.
+    std::vector<coro::task<void>> tasks;
+    for (auto const& mirror : m_options.sources[section].mirrors) {
+        if (m_mirrors.claim_probe(mirror)) {
+            tasks.emplace_back(probe_mirror(section, mirror, path));
         }
     }
 
-    return false;
+    if (tasks.empty()) {
+        co_return;
+    }
+
+    co_await coro::when_all(std::move(tasks));
+
+    for (auto const& mirror : m_mirrors.stats(m_options.sources[section].mirrors)) {
+        logd("Mirror {}: {}ms, {:.1f} KiB/s, {}", mirror.url,
+             mirror.latency ? mirror.latency->count() : -1, mirror.throughput / 1024,
+             mirror.available ? "available" : "skipped");
+    }
 }
 
-coro::task<std::unique_ptr<httplib::SSLClient>>
-    ArchRepoSyncService::get_client(std::string const url) {
+coro::task<void> ArchRepoSyncService::probe_mirror(PackageSectionDTO const section,
+                                                   std::string const mirror,
+                                                   std::string const path) {
+    // A probe is a request to the host like any other, so it's subject to
+    // the same limits as the downloads
+    auto permit = co_await m_downloads.acquire(bxt::to_string(section), mirror);
+
+    auto client = co_await get_client(mirror);
+    if (!client) {
+        m_mirrors.record_failure(mirror);
+        co_return;
+    }
+
+    auto const started = Utilities::Http::MirrorSelector::Clock::now();
+    auto const response = client->Head(path);
+
+    if (!response) {
+        client.discard();
+    }
+
+    if (!response || response->status >= 400) {
+        m_mirrors.record_probe(mirror, std::nullopt);
+        co_return;
+    }
+
+    m_mirrors.record_probe(mirror, Utilities::Http::MirrorSelector::Clock::now() - started);
+}
+
+bool ArchRepoSyncService::is_excluded(PackageSectionDTO const& section,
+                                      std::string const& package_name) const {
+    return m_options.sources.at(section).exclude_matcher.matches(package_name);
+}
+
+std::unique_ptr<httplib::SSLClient> ArchRepoSyncService::make_client(std::string const& url) {
     using namespace std::chrono_literals;
     constexpr static auto timeout = 5s;
 
-    co_await tp->schedule();
-
     auto client_ptr = std::make_unique<httplib::SSLClient>(url);
 
     client_ptr->set_follow_location(true);
     client_ptr->enable_server_certificate_verification(true);
     client_ptr->set_connection_timeout(timeout);
+    client_ptr->set_keep_alive(true);
+
+    return client_ptr;
+}
+
+coro::task<ArchRepoSyncService::ClientPool::Lease>
+    ArchRepoSyncService::get_client(std::string const url) {
+    co_await tp->schedule();
 
-    co_return client_ptr;
+    co_return m_clients.acquire(url);
 }
 
 } // namespace bxt::Infrastructure
@@ -7,6 +7,9 @@
 #pragma once
 
 #include "ArchRepoOptions.h"
+#include "ContentStore.h"
+#include "DownloadCache.h"
+#include "FileHashCache.h"
 #include "core/application/RequestContext.h"
 #include "core/application/services/SyncService.h"
 #include "core/domain/entities/Package.h"
@@ -14,11 +17,23 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "utilities/Error.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
+#include "utilities/http/ChunkPipe.h"
+#include "utilities/http/ClientPool.h"
+#include "utilities/http/DownloadScheduler.h"
+#include "utilities/http/MirrorSelector.h"
+#include "utilities/libarchive/Reader.h"
 
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
+#include <chrono>
 #include <coro/io_scheduler.hpp>
 #include <coro/thread_pool.hpp>
+#include <cstdint>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
 #include <vector>
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
@@ -44,6 +59,20 @@ public:
         Core::Domain::PackageVersion version;
         std::string hash;
         std::optional<std::string> signature;
+        // The desc entry as it is in the upstream database
+        std::string desc;
+        // Compressed size, 0 if the database doesn't have it
+        uint64_t size = 0;
+    };
+
+    // How long the saves of synced packages waited for the write
+    // transaction and how long they held it
+    struct SaveStats {
+        uint64_t saves = 0;
+        std::chrono::milliseconds lock_wait {0};
+        std::chrono::milliseconds max_lock_wait {0};
+        std::chrono::milliseconds lock_hold {0};
+        std::chrono::milliseconds max_lock_hold {0};
     };
 
     ArchRepoSyncService(Utilities::EventBusDispatcher& dispatcher,
@@ -52,30 +81,157 @@ public:
                         UnitOfWorkBaseFactory& uow_factory)
         : m_dispatcher(dispatcher)
         , m_package_repository(package_repository)
+        , m_uow_factory(uow_factory)
         , m_options(options)
-        , m_uow_factory(uow_factory) {
+        , m_clients(make_client,
+                    m_options.connection_pool_size,
+                    m_options.connection_idle_timeout)
+        , m_hashes(m_options.download_path / ".hash-cache")
+        , m_content(m_options.download_path / ".content")
+        , m_cache(m_options.download_path, m_options.download_cache_size, m_hashes, m_content)
+        , m_mirrors({.failure_threshold = m_options.mirror_failure_threshold,
+                     .cooldown = m_options.mirror_cooldown}) {
     }
 
     coro::task<SyncService::Result<void>> sync(PackageSectionDTO const section,
                                                RequestContext const context) override;
     coro::task<SyncService::Result<void>> sync_all(RequestContext const context) override;
 
+    coro::task<std::vector<SyncPlanDTO>> plan_all() override;
+
+    // Hit, miss and eviction counters of the download cache
+    DownloadCache::Stats download_cache_stats() const {
+        return m_cache.stats();
+    }
+
+    SaveStats save_stats() const {
+        std::scoped_lock const lock(m_save_stats_mutex);
+        return m_save_stats;
+    }
+
 protected:
-    coro::task<SyncService::Result<std::vector<Package>>>
-        sync_section(PackageSectionDTO const section);
+    // Downloads the new packages of a section and saves them as they
+    // finish. What's saved is added to synced_packages, without the descs.
+    coro::task<SyncService::Result<void>> sync_section(PackageSectionDTO const section,
+                                                       std::vector<Package>& synced_packages);
+
+    // The downloads of a section that is being synced. Finished packages
+    // are buffered and saved by one task at a time, the others keep
+    // downloading meanwhile.
+    struct SectionPipeline {
+        PackageSectionDTO section;
+        std::size_t total = 0;
+        std::vector<Package>& synced_packages;
+
+        std::mutex mutex;
+        std::vector<Package> buffer;
+        // Packages of the chunks that failed to save, retried once when the
+        // downloads are done
+        std::vector<Package> unsaved;
+        bool saving = false;
+        std::optional<DownloadError> download_failure;
+        std::optional<SyncError> save_failure;
+    };
+
+    coro::task<void> fetch_and_save(PackageInfo pkginfo, SectionPipeline& pipeline);
+
+    // Saves the buffered packages as long as there are at least min_size
+    // of them
+    coro::task<void> save_buffered(SectionPipeline& pipeline, std::size_t min_size);
+
+    // Diffs the last fetched index of the section against the local
+    // versions. The .db is only downloaded if it was never fetched.
+    coro::task<SyncService::Result<SyncPlanDTO>> plan_section(PackageSectionDTO const section);
+
+    // Saves already downloaded packages in a single short write transaction
+    coro::task<SyncService::Result<void>> save_packages(std::vector<Package> const& packages);
+
+    // The last fetched .db of a section, parsed. Its validators make the
+    // next fetch conditional, so an unchanged .db is neither downloaded nor
+    // parsed again.
+    struct SectionIndex {
+        std::string etag;
+        std::string last_modified;
+        std::vector<PackageInfo> packages;
+    };
+    using SectionIndexPtr = std::shared_ptr<SectionIndex const>;
 
-    coro::task<Result<std::vector<PackageInfo>>>
-        get_available_packages(PackageSectionDTO const section);
-    coro::task<Result<Package>>
-        download_package(PackageSectionDTO section,
-                         std::string package_filename,
-                         std::string sha256_hash,
-                         std::optional<std::string> signature = std::nullopt);
+    coro::task<Result<SectionIndexPtr>> fetch_index(PackageSectionDTO const section);
 
-    coro::task<std::unique_ptr<httplib::SSLClient>> get_client(std::string const url);
+    Result<std::vector<PackageInfo>> read_index(std::string const& path,
+                                                Archive::Reader& reader) const;
+    // Parses the .db while it's being downloaded, reading it from the pipe
+    Result<std::vector<PackageInfo>> parse_stream(std::string const& path,
+                                                  Utilities::Http::ChunkPipe& pipe) const;
 
+    // Returns the index of the last fetch, loading it from the disk after a
+    // restart, or nullptr if there is none
+    SectionIndexPtr cached_index(PackageSectionDTO const& section);
+    // Keeps the index, and the downloaded body at body_path for the next
+    // start unless it's empty
+    void store_index(PackageSectionDTO const& section,
+                     SectionIndexPtr index,
+                     std::filesystem::path const& body_path);
+    std::filesystem::path index_path(PackageSectionDTO const& section) const;
+
+    // Remembers that a sync saved every package of the index it diffed, so
+    // while the .db is not modified the next syncs have nothing to do
+    void mark_synced(PackageSectionDTO const& section, SectionIndexPtr index);
+    bool is_synced(PackageSectionDTO const& section, SectionIndexPtr const& index);
+
+    struct AvailablePackages {
+        // The index the packages were diffed from
+        SectionIndexPtr index;
+        std::vector<PackageInfo> packages;
+    };
+
+    coro::task<Result<AvailablePackages>> get_available_packages(PackageSectionDTO const section);
+    coro::task<Result<Package>> download_package(PackageSectionDTO section, PackageInfo pkginfo);
+
+    // Downloads a single package, retrying it with a backoff when it fails
+    coro::task<Result<Package>> fetch_package(PackageSectionDTO section, PackageInfo pkginfo);
+
+    std::chrono::milliseconds retry_delay(int attempt) const;
+
+    using ClientPool = Utilities::Http::ClientPool<httplib::SSLClient>;
+
+    static std::unique_ptr<httplib::SSLClient> make_client(std::string const& url);
+
+    // Leases a keep-alive client for the mirror host, reusing an idle
+    // connection when there is one
+    coro::task<ClientPool::Lease> get_client(std::string const url);
+
+    // Downloads are queued per section in the download scheduler, so the
+    // sections of a sync take turns for the free download slots. The body
+    // is passed to the content receiver as it arrives. Every request goes
+    // to the mirror picked by the mirror selector, and its outcome is
+    // recorded there.
     coro::task<std::optional<httplib::Result>>
-        download_file(std::string url, std::string path, std::string filename = "");
+        stream_file(PackageSectionDTO section,
+                    std::string path,
+                    httplib::Headers headers,
+                    httplib::ResponseHandler response_handler,
+                    httplib::ContentReceiver content_receiver);
+
+    // Downloads into a file, resuming from what an interrupted attempt left
+    // behind. The hash identifies the file that is being resumed. If it's
+    // given, the file is hashed while it's received and only kept if it
+    // matches.
+    coro::task<std::optional<httplib::Result>> download_file(PackageSectionDTO section,
+                                                             std::string path,
+                                                             std::string filename,
+                                                             std::string sha256_hash = "");
+
+    // Measures the latency of the mirrors of a section with a HEAD request
+    // of the path, so the first downloads already go to the fast ones. Each
+    // mirror is probed at most once per breaker cooldown.
+    coro::task<void> probe_mirrors(PackageSectionDTO const section, std::string const path);
+    coro::task<void> probe_mirror(PackageSectionDTO const section,
+                                  std::string const mirror,
+                                  std::string const path);
+
+    // Evicts the least recently used files over the download cache budget
+    void trim_download_cache();
 
     bool is_excluded(PackageSectionDTO const& section, std::string const& package_name) const;
 
@@ -85,8 +241,24 @@ private:
     UnitOfWorkBaseFactory& m_uow_factory;
 
     ArchRepoOptions m_options;
-    std::shared_ptr<coro::io_scheduler> tp =
-        coro::io_scheduler::make_shared({.pool = {.thread_count = 4}});
+    ClientPool m_clients;
+    FileHashCache m_hashes;
+    ContentStore m_content;
+    DownloadCache m_cache;
+    Utilities::Http::MirrorSelector m_mirrors;
+
+    mutable std::mutex m_save_stats_mutex;
+    SaveStats m_save_stats;
+
+    std::mutex m_indexes_mutex;
+    phmap::flat_hash_map<PackageSectionDTO, SectionIndexPtr> m_indexes;
+    phmap::flat_hash_map<PackageSectionDTO, SectionIndexPtr> m_synced_indexes;
+    // Requests are blocking, so every download slot needs its own thread
+    std::shared_ptr<coro::io_scheduler> tp = coro::io_scheduler::make_shared(
+        {.pool = {.thread_count =
+                      static_cast<uint32_t>(std::max<std::size_t>(m_options.max_downloads, 1))}});
+    Utilities::Http::DownloadScheduler m_downloads {tp, m_options.max_downloads,
+                                                    m_options.max_downloads_per_host};
 };
 
 } // namespace bxt::Infrastructure
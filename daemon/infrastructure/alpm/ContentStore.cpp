@@ -0,0 +1,128 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "ContentStore.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <cctype>
+#include <system_error>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+ContentStore::ContentStore(std::filesystem::path path)
+    : m_path(std::move(path)) {
+}
+
+void ContentStore::add(std::string const& sha256sum, std::filesystem::path const& filepath) {
+    auto const blob = blob_path(sha256sum);
+    if (blob.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    if (std::filesystem::exists(blob, ec)) {
+        return;
+    }
+
+    std::filesystem::create_directories(blob.parent_path(), ec);
+
+    // A copy would take the space the store is there to save, so a file
+    // that can't be linked is just not added
+    std::filesystem::create_hard_link(filepath, blob, ec);
+    if (ec && ec != std::errc::file_exists) {
+        logd("ContentStore: Can't link {} as {}: {}", filepath.string(), blob.string(),
+             ec.message());
+    }
+}
+
+bool ContentStore::contains(std::string const& sha256sum) const {
+    auto const blob = blob_path(sha256sum);
+
+    std::error_code ec;
+    return !blob.empty() && std::filesystem::exists(blob, ec);
+}
+
+std::optional<std::filesystem::path>
+    ContentStore::blob_of(std::string const& sha256sum,
+                          std::filesystem::path const& filepath) const {
+    auto const blob = blob_path(sha256sum);
+    if (blob.empty()) {
+        return std::nullopt;
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::equivalent(blob, filepath, ec) || ec) {
+        return std::nullopt;
+    }
+
+    return blob;
+}
+
+bool ContentStore::link_to(std::string const& sha256sum, std::filesystem::path const& target) {
+    auto const blob = blob_path(sha256sum);
+    if (blob.empty()) {
+        return false;
+    }
+
+    std::error_code ec;
+    auto const size = std::filesystem::file_size(blob, ec);
+    if (ec) {
+        return false;
+    }
+
+    std::filesystem::remove(target, ec);
+
+    std::filesystem::create_hard_link(blob, target, ec);
+    if (ec) {
+        ec.clear();
+        std::filesystem::copy_file(blob, target, std::filesystem::copy_options::overwrite_existing,
+                                   ec);
+    }
+    if (ec) {
+        logw("ContentStore: Can't link {} to {}: {}", blob.string(), target.string(),
+             ec.message());
+        return false;
+    }
+
+    m_bytes_saved += size;
+
+    return true;
+}
+
+std::size_t ContentStore::collect_garbage() {
+    std::error_code ec;
+    std::vector<std::filesystem::path> unreferenced;
+
+    for (auto const& entry : std::filesystem::recursive_directory_iterator(m_path, ec)) {
+        std::error_code entry_ec;
+        if (entry.is_regular_file(entry_ec) && entry.hard_link_count(entry_ec) == 1) {
+            unreferenced.emplace_back(entry.path());
+        }
+    }
+
+    for (auto const& blob : unreferenced) {
+        std::filesystem::remove(blob, ec);
+    }
+
+    return unreferenced.size();
+}
+
+std::filesystem::path ContentStore::blob_path(std::string const& sha256sum) const {
+    // The sum comes from the upstream database, it must not be able to
+    // point anywhere else
+    if (sha256sum.size() != 64 || !std::ranges::all_of(sha256sum, [](unsigned char c) {
+            return std::isdigit(c) || (c >= 'a' && c <= 'f');
+        })) {
+        return {};
+    }
+
+    return m_path / sha256sum.substr(0, 2) / sha256sum;
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,58 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Verified package files addressed by their SHA256, so a package that was
+// already downloaded for one section is linked into another one instead of
+// being downloaded again.
+//
+// Every blob is a hard link to a downloaded file, "<path>/<ab>/<sha256>".
+// It shares the inode with the file, which keeps sharing it after the file
+// is moved to the pool, so the store indexes the pool as well without
+// taking any space of its own. Nothing is ever written to a linked file in
+// place: downloads go to a new file that is renamed over the old one.
+class ContentStore {
+public:
+    explicit ContentStore(std::filesystem::path path);
+
+    // Adds a file that is verified to have the given SHA256
+    void add(std::string const& sha256sum, std::filesystem::path const& filepath);
+
+    bool contains(std::string const& sha256sum) const;
+
+    // The blob the file is linked to, if it's the one with the given SHA256
+    std::optional<std::filesystem::path> blob_of(std::string const& sha256sum,
+                                                 std::filesystem::path const& filepath) const;
+
+    // Links the blob with the given SHA256 to target, copying it if it
+    // can't be linked. False if there is no such blob.
+    bool link_to(std::string const& sha256sum, std::filesystem::path const& target);
+
+    // Removes the blobs that nothing links to anymore, returns their number
+    std::size_t collect_garbage();
+
+    // Bytes linked instead of downloaded since the last call
+    uint64_t take_bytes_saved() {
+        return m_bytes_saved.exchange(0);
+    }
+
+private:
+    std::filesystem::path blob_path(std::string const& sha256sum) const;
+
+    std::filesystem::path m_path;
+    std::atomic<uint64_t> m_bytes_saved = 0;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,228 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "DownloadCache.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+DownloadCache::DownloadCache(std::filesystem::path path,
+                             uint64_t budget,
+                             FileHashCache const& hashes,
+                             ContentStore const& content)
+    : m_path(std::move(path))
+    , m_budget(budget)
+    , m_hashes(hashes)
+    , m_content(content) {
+    std::error_code ec;
+    std::vector<std::pair<std::filesystem::file_time_type, std::string>> files;
+
+    for (auto it = std::filesystem::recursive_directory_iterator(m_path, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code entry_ec;
+
+        if (it->is_directory(entry_ec)) {
+            if (it->path().filename().string().starts_with(".")) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+
+        if (!it->is_regular_file(entry_ec) || !is_managed(it->path())) {
+            continue;
+        }
+
+        auto const mtime = it->last_write_time(entry_ec);
+        if (!entry_ec) {
+            files.emplace_back(mtime, it->path().string());
+        }
+    }
+
+    // Nothing is known about the use of the files from before the start,
+    // the ones modified last are assumed to be used last
+    std::ranges::sort(files);
+
+    std::scoped_lock const lock(m_mutex);
+    for (auto const& [mtime, filepath] : files) {
+        touch(filepath);
+    }
+}
+
+void DownloadCache::record_hit(std::filesystem::path const& filepath) {
+    std::scoped_lock const lock(m_mutex);
+
+    ++m_stats.hits;
+    touch(filepath.string());
+}
+
+void DownloadCache::record_miss(std::filesystem::path const& filepath) {
+    std::scoped_lock const lock(m_mutex);
+
+    ++m_stats.misses;
+    touch(filepath.string());
+}
+
+void DownloadCache::forget(std::filesystem::path const& filepath) {
+    std::scoped_lock const lock(m_mutex);
+
+    erase(filepath.string());
+}
+
+std::size_t DownloadCache::evict() {
+    std::scoped_lock const lock(m_mutex);
+
+    // The pool may have taken or released files since they were added, so
+    // the sizes are refreshed first
+    uint64_t usage = 0;
+    std::vector<std::string> gone;
+
+    for (auto const& filepath : m_lru) {
+        auto file_usage = usage_of(filepath);
+        if (!file_usage) {
+            gone.push_back(filepath);
+            continue;
+        }
+
+        usage += file_usage->size;
+        m_entries[filepath].usage = std::move(*file_usage);
+    }
+
+    for (auto const& filepath : gone) {
+        erase(filepath);
+    }
+
+    if (m_budget == 0 || usage <= m_budget) {
+        return 0;
+    }
+
+    std::size_t evicted = 0;
+
+    for (auto it = m_lru.end(); it != m_lru.begin() && usage > m_budget;) {
+        --it;
+
+        auto const filepath = *it;
+        auto const entry = m_entries.find(filepath);
+        auto const& [size, blob] = entry->second.usage;
+
+        if (size == 0) {
+            continue;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(filepath, ec);
+        if (ec) {
+            logw("DownloadCache: Can't evict {}: {}", filepath, ec.message());
+            continue;
+        }
+        std::filesystem::remove(filepath + ".sig", ec);
+        if (!blob.empty()) {
+            std::filesystem::remove(blob, ec);
+        }
+
+        logd("DownloadCache: Evicted {} ({} KiB)", filepath, size / 1024);
+
+        usage -= size;
+        ++evicted;
+        ++m_stats.evictions;
+        m_stats.evicted_bytes += size;
+
+        m_entries.erase(entry);
+        it = m_lru.erase(it);
+    }
+
+    return evicted;
+}
+
+DownloadCache::Stats DownloadCache::stats() const {
+    std::scoped_lock const lock(m_mutex);
+
+    auto result = m_stats;
+    result.files = m_entries.size();
+    result.bytes = 0;
+    for (auto const& [filepath, entry] : m_entries) {
+        result.bytes += entry.usage.size;
+    }
+
+    return result;
+}
+
+bool DownloadCache::is_managed(std::filesystem::path const& filepath) {
+    auto const filename = filepath.filename().string();
+
+    // Signatures go together with their packages
+    return !filename.starts_with(".") && !filename.ends_with(".part")
+           && !filename.ends_with(".part.meta") && !filename.ends_with(".sig");
+}
+
+std::optional<DownloadCache::Usage> DownloadCache::usage_of(std::string const& filepath) const {
+    std::error_code ec;
+
+    auto const links = std::filesystem::hard_link_count(filepath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    auto const size = std::filesystem::file_size(filepath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    if (links == 1) {
+        return Usage {.size = size};
+    }
+
+    // The only other link may be the content store's one, the pool doesn't
+    // share the file then
+    if (links == 2) {
+        if (auto const sha256sum = m_hashes.sha256sum(filepath)) {
+            if (auto blob = m_content.blob_of(*sha256sum, filepath)) {
+                return Usage {.size = size, .blob = std::move(*blob)};
+            }
+        }
+    }
+
+    return Usage {};
+}
+
+void DownloadCache::touch(std::string const& filepath) {
+    if (!is_managed(filepath)) {
+        return;
+    }
+
+    auto file_usage = usage_of(filepath);
+    if (!file_usage) {
+        return;
+    }
+
+    if (auto const entry = m_entries.find(filepath); entry != m_entries.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, entry->second.position);
+        entry->second.usage = std::move(*file_usage);
+        return;
+    }
+
+    m_lru.push_front(filepath);
+    m_entries.emplace(filepath,
+                      Entry {.position = m_lru.begin(), .usage = std::move(*file_usage)});
+}
+
+void DownloadCache::erase(std::string const& filepath) {
+    auto const entry = m_entries.find(filepath);
+    if (entry == m_entries.end()) {
+        return;
+    }
+
+    m_lru.erase(entry->second.position);
+    m_entries.erase(entry);
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,96 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "ContentStore.h"
+#include "FileHashCache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Keeps the package files in the download path within a byte budget,
+// evicting the least recently used ones. Synced packages are moved to the
+// pool, so what stays here are the files of syncs that didn't finish and
+// the files the pool shares through hard links.
+//
+// A file the pool still links to wouldn't free anything if it was removed,
+// so it's neither counted nor evicted. The content store links to every
+// verified download as well, that link alone doesn't make a file shared:
+// evicting such a file removes its blob with it. Dotfiles (indexes, the
+// hash cache, the content store) and partial downloads are not managed.
+// The verified hashes of the files are kept by the FileHashCache, so a hit
+// doesn't read the file.
+class DownloadCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t evicted_bytes = 0;
+        std::size_t files = 0;
+        uint64_t bytes = 0;
+    };
+
+    // A budget of 0 means the cache is not limited
+    DownloadCache(std::filesystem::path path,
+                  uint64_t budget,
+                  FileHashCache const& hashes,
+                  ContentStore const& content);
+
+    // A cached file was used instead of downloading it
+    void record_hit(std::filesystem::path const& filepath);
+    // A file was downloaded into the cache
+    void record_miss(std::filesystem::path const& filepath);
+    // The file left the cache, e.g. it was moved to the pool
+    void forget(std::filesystem::path const& filepath);
+
+    // Evicts files until the cache fits the budget, returns their number
+    std::size_t evict();
+
+    Stats stats() const;
+
+private:
+    struct Usage {
+        // Bytes the file takes only for the cache, 0 if it's shared with
+        // the pool
+        uint64_t size = 0;
+        // The content store's link to the file, empty if there is none
+        std::filesystem::path blob;
+    };
+
+    struct Entry {
+        std::list<std::string>::iterator position;
+        Usage usage;
+    };
+
+    static bool is_managed(std::filesystem::path const& filepath);
+    // std::nullopt if the file is gone
+    std::optional<Usage> usage_of(std::string const& filepath) const;
+    // Starts tracking the file as the most recently used one
+    void touch(std::string const& filepath);
+    void erase(std::string const& filepath);
+
+    std::filesystem::path m_path;
+    uint64_t m_budget;
+    FileHashCache const& m_hashes;
+    ContentStore const& m_content;
+
+    mutable std::mutex m_mutex;
+    // The most recently used file is at the front
+    std::list<std::string> m_lru;
+    phmap::flat_hash_map<std::string, Entry> m_entries;
+    Stats m_stats;
+};
+
+} // namespace bxt::Infrastructure
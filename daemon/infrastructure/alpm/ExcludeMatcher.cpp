@@ -0,0 +1,93 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "ExcludeMatcher.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/join.hpp>
+#include <fmt/format.h>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    bool is_literal(std::string_view pattern) {
+        return pattern.find_first_of(R"(\^$.|?*+()[]{})") == std::string_view::npos;
+    }
+} // namespace
+
+bool ExcludeMatcher::matches(std::string_view name) const {
+    if (m_names.contains(name)) {
+        return true;
+    }
+
+    for (auto const& prefix : m_prefixes) {
+        if (name.starts_with(prefix)) {
+            return true;
+        }
+    }
+
+    for (auto const& suffix : m_suffixes) {
+        if (name.ends_with(suffix)) {
+            return true;
+        }
+    }
+
+    return m_regex && std::regex_match(name.begin(), name.end(), *m_regex);
+}
+
+void ExcludeMatcher::add(std::string const& pattern, std::vector<std::string>& regex_patterns) {
+    constexpr std::string_view any = ".*";
+
+    if (pattern.empty()) {
+        return;
+    }
+
+    if (is_literal(pattern)) {
+        m_names.emplace(pattern);
+        return;
+    }
+
+    std::string_view const view = pattern;
+
+    if (view.ends_with(any) && is_literal(view.substr(0, view.size() - any.size()))) {
+        m_prefixes.emplace_back(view.substr(0, view.size() - any.size()));
+        return;
+    }
+
+    if (view.starts_with(any) && is_literal(view.substr(any.size()))) {
+        m_suffixes.emplace_back(view.substr(any.size()));
+        return;
+    }
+
+    // An invalid pattern would make the combined expression invalid as well,
+    // so every pattern is checked on its own first
+    try {
+        std::regex const validated(pattern);
+    } catch (std::regex_error const& error) {
+        logw("Invalid exclude pattern \"{}\" is ignored: {}", pattern, error.what());
+        return;
+    }
+
+    regex_patterns.emplace_back(fmt::format("(?:{})", pattern));
+}
+
+void ExcludeMatcher::compile(std::vector<std::string> const& regex_patterns) {
+    // Shorter prefixes and suffixes are the more general ones, so they are
+    // checked first
+    std::ranges::sort(m_prefixes, {}, &std::string::size);
+    std::ranges::sort(m_suffixes, {}, &std::string::size);
+
+    if (regex_patterns.empty()) {
+        return;
+    }
+
+    m_regex.emplace(boost::algorithm::join(regex_patterns, "|"),
+                    std::regex::ECMAScript | std::regex::optimize);
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,55 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+// Exclude list of a sync source, compiled once. A package name is excluded
+// if it fully matches any of the patterns (ECMAScript, as std::regex_match).
+//
+// Most patterns of real exclude lists are package names or simple globs,
+// so they don't go through the regex engine at all: plain names are looked
+// up in a hash set, "prefix.*" and ".*suffix" are compared as strings.
+// The remaining patterns are combined into a single alternation.
+class ExcludeMatcher {
+public:
+    ExcludeMatcher() = default;
+
+    template<typename TPatterns> explicit ExcludeMatcher(TPatterns const& patterns) {
+        std::vector<std::string> regex_patterns;
+
+        for (auto const& pattern : patterns) {
+            add(pattern, regex_patterns);
+        }
+
+        compile(regex_patterns);
+    }
+
+    bool matches(std::string_view name) const;
+
+    bool empty() const {
+        return m_names.empty() && m_prefixes.empty() && m_suffixes.empty() && !m_regex;
+    }
+
+private:
+    void add(std::string const& pattern, std::vector<std::string>& regex_patterns);
+    void compile(std::vector<std::string> const& regex_patterns);
+
+    phmap::flat_hash_set<std::string> m_names;
+    std::vector<std::string> m_prefixes;
+    std::vector<std::string> m_suffixes;
+    std::optional<std::regex> m_regex;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,146 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "FileHashCache.h"
+
+#include "utilities/hash_from_file.h"
+#include "utilities/log/Logging.h"
+
+#include <openssl/sha.h>
+#include <sstream>
+#include <system_error>
+
+namespace bxt::Infrastructure {
+
+FileHashCache::FileHashCache(std::filesystem::path path)
+    : m_path(std::move(path)) {
+    std::ifstream existing(m_path);
+
+    std::string line;
+    while (std::getline(existing, line)) {
+        std::istringstream fields(line);
+
+        Entry entry;
+        std::string filepath;
+        // A line cut off by a crash doesn't parse and is ignored
+        if (!(fields >> entry.sha256sum >> entry.size >> entry.mtime) || !(fields >> std::ws)
+            || !std::getline(fields, filepath) || filepath.empty()) {
+            continue;
+        }
+
+        m_entries.insert_or_assign(std::move(filepath), std::move(entry));
+    }
+    existing.close();
+
+    compact();
+}
+
+std::optional<std::string> FileHashCache::sha256sum(std::filesystem::path const& filepath) const {
+    auto const current = stat(filepath);
+    if (!current) {
+        return std::nullopt;
+    }
+
+    std::scoped_lock const lock(m_mutex);
+
+    auto const entry = m_entries.find(filepath.string());
+    if (entry == m_entries.end() || entry->second.size != current->size
+        || entry->second.mtime != current->mtime) {
+        return std::nullopt;
+    }
+
+    return entry->second.sha256sum;
+}
+
+void FileHashCache::store(std::filesystem::path const& filepath, std::string sha256sum) {
+    auto entry = stat(filepath);
+    if (!entry || sha256sum.empty()) {
+        return;
+    }
+    entry->sha256sum = std::move(sha256sum);
+
+    std::scoped_lock const lock(m_mutex);
+
+    if (m_stream.is_open()) {
+        m_stream << entry->sha256sum << ' ' << entry->size << ' ' << entry->mtime << ' '
+                 << filepath.string() << '\n';
+        m_stream.flush();
+    }
+
+    m_entries.insert_or_assign(filepath.string(), std::move(*entry));
+}
+
+std::string FileHashCache::hash(std::filesystem::path const& filepath) {
+    if (auto cached = sha256sum(filepath)) {
+        return std::move(*cached);
+    }
+
+    auto const before = stat(filepath);
+    if (!before) {
+        return {};
+    }
+
+    auto result = bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(filepath);
+
+    // A file that was written to while it was hashed is not cached
+    auto const after = stat(filepath);
+    if (after && after->size == before->size && after->mtime == before->mtime) {
+        store(filepath, result);
+    }
+
+    return result;
+}
+
+std::size_t FileHashCache::size() const {
+    std::scoped_lock const lock(m_mutex);
+
+    return m_entries.size();
+}
+
+std::optional<FileHashCache::Entry> FileHashCache::stat(std::filesystem::path const& filepath) {
+    std::error_code ec;
+
+    auto const size = std::filesystem::file_size(filepath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    auto const mtime = std::filesystem::last_write_time(filepath, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    return Entry {.size = size, .mtime = static_cast<int64_t>(mtime.time_since_epoch().count())};
+}
+
+void FileHashCache::compact() {
+    std::scoped_lock const lock(m_mutex);
+
+    phmap::erase_if(m_entries, [](auto const& entry) {
+        auto const current = stat(entry.first);
+
+        return !current || current->size != entry.second.size
+               || current->mtime != entry.second.mtime;
+    });
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_path.parent_path(), ec);
+
+    m_stream.close();
+    m_stream.open(m_path, std::ios::trunc);
+    if (!m_stream.is_open()) {
+        logw("Can't open the hash cache {}, file hashes will not be kept", m_path.string());
+        return;
+    }
+
+    for (auto const& [filepath, entry] : m_entries) {
+        m_stream << entry.sha256sum << ' ' << entry.size << ' ' << entry.mtime << ' ' << filepath
+                 << '\n';
+    }
+    m_stream.flush();
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,63 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// SHA256 sums of files in the download cache, so a file that didn't change
+// since it was verified is not hashed again by every sync. A file is
+// identified by its path, size and modification time; any change to it
+// makes the cached sum stale.
+//
+// The cache is an append-only file of "<sha256> <size> <mtime> <path>"
+// lines, the later of two lines for the same path wins. It's compacted on
+// load and after every sync, so it doesn't keep growing in a long running
+// daemon.
+class FileHashCache {
+public:
+    explicit FileHashCache(std::filesystem::path path);
+
+    // The cached sum, if the file is still the one it was computed for
+    std::optional<std::string> sha256sum(std::filesystem::path const& filepath) const;
+
+    void store(std::filesystem::path const& filepath, std::string sha256sum);
+
+    // The cached sum, or hashes the file and caches the result. Empty if
+    // the file can't be read.
+    std::string hash(std::filesystem::path const& filepath);
+
+    std::size_t size() const;
+
+    // Rewrites the file without the entries of files that are gone or
+    // changed
+    void compact();
+
+private:
+    struct Entry {
+        std::string sha256sum;
+        uintmax_t size = 0;
+        int64_t mtime = 0;
+    };
+
+    static std::optional<Entry> stat(std::filesystem::path const& filepath);
+
+    std::filesystem::path m_path;
+
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, Entry> m_entries;
+    std::ofstream m_stream;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,142 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "PartialDownload.h"
+
+#include <charconv>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+PartialDownload::PartialDownload(std::filesystem::path target,
+                                 std::string source,
+                                 std::string sha256sum)
+    : m_target(std::move(target))
+    , m_part_path(m_target.string() + ".part")
+    , m_marker_path(m_target.string() + ".part.meta")
+    , m_source(std::move(source))
+    , m_sha256sum(std::move(sha256sum)) {
+}
+
+uint64_t PartialDownload::resumable_size() {
+    std::error_code ec;
+
+    auto const size = std::filesystem::file_size(m_part_path, ec);
+    if (ec || size == 0) {
+        discard();
+        return 0;
+    }
+
+    std::ifstream marker_file(m_marker_path, std::ios::binary);
+    std::string const existing_marker {std::istreambuf_iterator<char>(marker_file),
+                                       std::istreambuf_iterator<char>()};
+
+    if (existing_marker != marker()) {
+        discard();
+        return 0;
+    }
+
+    return size;
+}
+
+bool PartialDownload::begin(bool resume) {
+    if (!resume) {
+        std::ofstream marker_file(m_marker_path, std::ios::binary | std::ios::trunc);
+        marker_file << marker();
+        if (!marker_file.flush()) {
+            return false;
+        }
+    }
+
+    m_hasher.emplace(EVP_sha256());
+
+    // Only the part that is already on the disk has to be read to continue
+    // the digest
+    if (resume) {
+        std::ifstream existing(m_part_path, std::ios::binary);
+        std::vector<char> block(64 * 1024);
+
+        while (existing.read(block.data(), static_cast<std::streamsize>(block.size()))
+               || existing.gcount() > 0) {
+            m_hasher->update(block.data(), static_cast<std::size_t>(existing.gcount()));
+        }
+
+        if (existing.bad()) {
+            return false;
+        }
+    }
+
+    m_stream.open(m_part_path, std::ios::binary | (resume ? std::ios::app : std::ios::trunc));
+
+    return m_stream.is_open();
+}
+
+bool PartialDownload::write(char const* data, std::size_t size) {
+    m_stream.write(data, static_cast<std::streamsize>(size));
+    m_hasher->update(data, size);
+
+    return m_stream.good();
+}
+
+bool PartialDownload::finish() {
+    m_stream.close();
+    if (!m_stream) {
+        return false;
+    }
+
+    if (m_hasher) {
+        m_received_sha256sum = m_hasher->hex_digest();
+        m_hasher.reset();
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(m_part_path, m_target, ec);
+    if (ec) {
+        return false;
+    }
+
+    std::filesystem::remove(m_marker_path, ec);
+
+    return true;
+}
+
+void PartialDownload::discard() {
+    if (m_stream.is_open()) {
+        m_stream.close();
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(m_part_path, ec);
+    std::filesystem::remove(m_marker_path, ec);
+}
+
+std::optional<uint64_t> PartialDownload::content_range_start(std::string const& content_range) {
+    constexpr std::string_view unit = "bytes ";
+
+    if (!content_range.starts_with(unit)) {
+        return std::nullopt;
+    }
+
+    uint64_t start = 0;
+    auto const begin = content_range.data() + unit.size();
+    auto const end = content_range.data() + content_range.size();
+
+    auto const [ptr, ec] = std::from_chars(begin, end, start);
+    if (ec != std::errc() || ptr == end || *ptr != '-') {
+        return std::nullopt;
+    }
+
+    return start;
+}
+
+std::string PartialDownload::marker() const {
+    return m_source + "\n" + m_sha256sum + "\n";
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,70 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/StreamingHasher.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// A download into a file that can be continued after it was interrupted.
+// The data goes to "<file>.part" and a "<file>.part.meta" marker next to it
+// records what is being downloaded: the source URL and the expected SHA256
+// (empty if unknown). A partial file is only resumed by a download of the
+// same source and hash, anything else starts over. The file gets its final
+// name only once the transfer is complete.
+//
+// The SHA256 of the file is computed from the data as it's written, so the
+// complete file doesn't have to be read again to verify it.
+class PartialDownload {
+public:
+    PartialDownload(std::filesystem::path target, std::string source, std::string sha256sum);
+
+    // Bytes that are already downloaded and can be resumed from. Partial
+    // files left by a different download are removed.
+    uint64_t resumable_size();
+
+    // Starts writing, appending to the partial file when resuming
+    bool begin(bool resume);
+    bool write(char const* data, std::size_t size);
+    // Moves the complete file to the target path
+    bool finish();
+    void discard();
+
+    // The SHA256 of the complete file, set by finish()
+    std::string const& received_sha256sum() const {
+        return m_received_sha256sum;
+    }
+
+    std::filesystem::path const& part_path() const {
+        return m_part_path;
+    }
+
+    // Parses the first byte position out of a "bytes <first>-<last>/<size>"
+    // Content-Range header value
+    static std::optional<uint64_t> content_range_start(std::string const& content_range);
+
+private:
+    std::string marker() const;
+
+    std::filesystem::path m_target;
+    std::filesystem::path m_part_path;
+    std::filesystem::path m_marker_path;
+    std::string m_source;
+    std::string m_sha256sum;
+    std::string m_received_sha256sum;
+
+    std::ofstream m_stream;
+    std::optional<StreamingHasher> m_hasher;
+};
+
+} // namespace bxt::Infrastructure
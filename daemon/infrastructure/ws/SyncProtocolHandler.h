@@ -53,6 +53,18 @@ private:
             m_callback(event_json);
         });
 
+        m_listener.listen<Core::Application::Events::SyncProgress>([this](auto const& event) {
+            Json::Value event_json;
+
+            event_json["type"] = "sync-progress";
+            event_json["when"] = fmt::format("{}", event.when);
+            event_json["section"] = event.section;
+            event_json["saved"] = static_cast<Json::UInt64>(event.saved_packages);
+            event_json["total"] = static_cast<Json::UInt64>(event.total_packages);
+
+            m_callback(event_json);
+        });
+
         m_listener.listen<Core::Application::Events::SyncFinished>([this](auto const& event) {
             m_sync_started = false;
             m_when = event.when;
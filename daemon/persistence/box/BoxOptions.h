@@ -8,18 +8,28 @@
 
 #include "utilities/configuration/Configuration.h"
 
+#include <cstdint>
 #include <filesystem>
 
 namespace bxt::Persistence::Box {
 
 struct BoxOptions {
     std::filesystem::path box_path = "box";
+    // Also export the .files database. Package file lists are then computed
+    // on the first export of each package.
+    bool export_files = false;
+    // Number of sections exported at the same time
+    int64_t export_threads = 4;
 
     void serialize(Utilities::Configuration& config) {
         config.set("box-path", box_path.string());
+        config.set("box-export-files", export_files);
+        config.set("box-export-threads", export_threads);
     }
     void deserialize(Utilities::Configuration const& config) {
         box_path = config.get<std::string>("box-path").value_or(box_path);
+        export_files = config.get<bool>("box-export-files").value_or(export_files);
+        export_threads = config.get<int64_t>("box-export-threads").value_or(export_threads);
     }
 };
 
@@ -37,25 +37,31 @@ namespace bxt::Persistence::Box {
 
 BoxRepository::BoxRepository(BoxOptions options,
                              PackageStoreBase& package_store,
-                             WritebackScheduler& writeback_sceduler,
-                             ExporterBase& exporter)
+                             WritebackScheduler& writeback_sceduler)
     : m_options(std::move(options))
     , m_package_store(package_store)
-    , m_scheduler(writeback_sceduler)
-    , m_exporter(exporter) {};
+    , m_scheduler(writeback_sceduler) {};
+
+// Packages that only come from a sync are published with the bulk sync
+// priority, everything else is an interactive change
+WritebackPriority writeback_priority(Package const& package) {
+    return package.location() == PoolLocation::Sync ? WritebackPriority::Sync
+                                                    : WritebackPriority::Interactive;
+}
 
 void BoxRepository::make_writeback_hook(Section const section,
-                                        std::shared_ptr<UnitOfWorkBase> uow) {
-    m_exporter.add_dirty_sections({SectionDTOMapper::to_dto(section)});
-
-    uow->hook(
-        [this, section = SectionDTOMapper::to_dto(section)] {
-            coro::sync_wait(m_scheduler.schedule([](auto self, auto section) -> coro::task<void> {
-                co_await self->m_exporter.export_to_disk();
-                co_return;
-            }(this, section)));
-        },
-        "Box::Exporter::WriteBack");
+                                        std::shared_ptr<UnitOfWorkBase> uow,
+                                        WritebackPriority priority) {
+    auto section_dto = SectionDTOMapper::to_dto(section);
+
+    // Named per section and priority, so a unit of work touching many
+    // packages schedules every section only once
+    auto const name = fmt::format("Box::Exporter::WriteBack::{}::{}", std::string(section_dto),
+                                  static_cast<int>(priority));
+
+    uow->hook([this, section = std::move(section_dto),
+               priority] { m_scheduler.schedule(section, priority); },
+              name);
 }
 
 coro::task<BoxRepository::TResult>
@@ -164,9 +170,8 @@ coro::task<BoxRepository::WriteResult<void>>
         }
     }
 
-    for (auto const section :
-         entity | std::views::transform([](auto const& pkg) { return pkg.section(); })) {
-        make_writeback_hook(section, uow);
+    for (auto const& package : entity) {
+        make_writeback_hook(package.section(), uow, writeback_priority(package));
     }
 
     co_return {};
@@ -180,7 +185,7 @@ coro::task<BoxRepository::WriteResult<void>>
                                                           WriteError::OperationError);
     }
 
-    make_writeback_hook(entity.section(), uow);
+    make_writeback_hook(entity.section(), uow, writeback_priority(entity));
 
     co_return {};
 }
@@ -245,9 +250,8 @@ coro::task<BoxRepository::WriteResult<void>>
         }
     }
 
-    for (auto const section :
-         entity | std::views::transform([](auto const& e) { return e.section(); })) {
-        make_writeback_hook(section, uow);
+    for (auto const& package : entity) {
+        make_writeback_hook(package.section(), uow, writeback_priority(package));
     }
     co_return {};
 }
@@ -260,7 +264,7 @@ coro::task<BoxRepository::WriteResult<void>>
                                                           WriteError::OperationError);
     }
 
-    make_writeback_hook(entity.section(), uow);
+    make_writeback_hook(entity.section(), uow, writeback_priority(entity));
 
     co_return {};
 }
@@ -333,4 +337,50 @@ coro::task<BoxRepository::TResult> BoxRepository::find_by_section_async(
     }
 }
 
+coro::task<BoxRepository::ReadResult<BoxRepository::VersionMap>>
+    BoxRepository::find_versions_by_section_async(Section const section,
+                                                  std::shared_ptr<UnitOfWorkBase> uow) {
+    VersionMap result;
+
+    // A single cursor pass over the section. The records are read without
+    // their file lists, only the VERSION field of each description is
+    // looked at and no entities are built.
+    auto accept_ok = co_await m_package_store.accept_descriptions(
+        [&result](std::string_view key, PackageDescriptionsRecord const& record) {
+            std::optional<std::pair<PoolLocation, PackageVersion>> preferred;
+
+            for (auto const& [location, description] : record.descriptions) {
+                if (preferred && static_cast<int>(preferred->first) < static_cast<int>(location)) {
+                    continue;
+                }
+
+                auto const version_field = description.descfile.get("VERSION");
+                if (!version_field) {
+                    continue;
+                }
+
+                auto version = PackageVersion::from_string(*version_field);
+                if (!version) {
+                    continue;
+                }
+
+                preferred.emplace(location, std::move(*version));
+            }
+
+            if (preferred) {
+                result.insert_or_assign(record.id.name, std::move(preferred->second));
+            }
+
+            return Utilities::NavigationAction::Next;
+        },
+        fmt::format("{}/", section.string()), uow);
+
+    if (!accept_ok.has_value()) {
+        co_return bxt::make_error_with_source<ReadError>(std::move(accept_ok.error()),
+                                                         ReadError::EntityFindError);
+    }
+
+    co_return result;
+}
+
 } // namespace bxt::Persistence::Box
@@ -13,7 +13,6 @@
 #include "core/domain/repositories/UnitOfWorkBase.h"
 #include "coro/task.hpp"
 #include "persistence/box/BoxOptions.h"
-#include "persistence/box/export/ExporterBase.h"
 #include "persistence/box/store/PackageStoreBase.h"
 #include "persistence/box/writeback/WritebackScheduler.h"
 #include "utilities/alpmdb/Database.h"
@@ -29,8 +28,7 @@ class BoxRepository : public Core::Domain::PackageRepositoryBase {
 public:
     BoxRepository(BoxOptions options,
                   PackageStoreBase& package_store,
-                  WritebackScheduler& writeback_sceduler,
-                  ExporterBase& exporter);
+                  WritebackScheduler& writeback_sceduler);
 
     coro::task<TResult> find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase> uow) override;
     coro::task<TResult> find_first_async(std::function<bool(Package const&)>,
@@ -65,13 +63,18 @@ public:
                                               Name const name,
                                               std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<ReadResult<VersionMap>>
+        find_versions_by_section_async(Section const section,
+                                       std::shared_ptr<UnitOfWorkBase> uow) override;
+
 private:
-    void make_writeback_hook(Section const section, std::shared_ptr<UnitOfWorkBase> uow);
+    void make_writeback_hook(Section const section,
+                             std::shared_ptr<UnitOfWorkBase> uow,
+                             WritebackPriority priority = WritebackPriority::Interactive);
     BoxOptions m_options;
 
     PackageStoreBase& m_package_store;
 
-    ExporterBase& m_exporter;
     WritebackScheduler& m_scheduler;
 
     std::filesystem::path m_root_path;
@@ -15,16 +15,24 @@
 #include "utilities/libarchive/Error.h"
 #include "utilities/NavigationAction.h"
 
+#include <algorithm>
 #include <archive.h>
+#include <chrono>
 #include <coro/sync_wait.hpp>
+#include <coro/when_all.hpp>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <parallel_hashmap/phmap.h>
+#include <set>
 #include <string_view>
 #include <system_error>
+#include <vector>
 
 namespace bxt::Persistence::Box {
 // Creates the symlink relative to target
@@ -52,11 +60,17 @@ std::expected<void, FsError> create_relative_symlink(std::filesystem::path const
 
 AlpmDBExporter::AlpmDBExporter(BoxOptions& box_options,
                                PackageStoreBase& package_store,
+                               FileListStore& file_list_store,
                                ReadOnlyRepositoryBase<Section>& section_repository,
                                UnitOfWorkBaseFactory& uow_factory)
     : m_box_path(box_options.box_path)
+    , m_export_files(box_options.export_files)
     , m_package_store(package_store)
-    , m_uow_factory(uow_factory) {
+    , m_file_list_store(file_list_store)
+    , m_uow_factory(uow_factory)
+    , m_export_pool(coro::thread_pool::options {
+          .thread_count =
+              static_cast<uint32_t>(std::max<int64_t>(box_options.export_threads, 1))}) {
     auto sections_result =
         coro::sync_wait(section_repository.all_async(coro::sync_wait(uow_factory())));
 
@@ -71,91 +85,72 @@ AlpmDBExporter::AlpmDBExporter(BoxOptions& box_options,
                            SectionDTOMapper::to_dto);
 
     for (auto const& section : m_sections) {
-        std::filesystem::create_directories(m_box_path / std::string(section));
+        if (auto setup_ok = setup_slots(section); !setup_ok) {
+            logf("Exporter: Can't prepare \"{}\" for the export, the reason is \"{}\". "
+                 "Exiting.",
+                 std::string(section), setup_ok.error().what());
+            exit(1);
+        }
     }
 }
 
-coro::task<void> AlpmDBExporter::export_to_disk() {
-    phmap::parallel_flat_hash_map<PackageSectionDTO, Archive::Writer> writers;
+coro::task<std::set<PackageSectionDTO>>
+    AlpmDBExporter::export_to_disk(std::set<PackageSectionDTO> sections) {
+    std::mutex failed_mutex;
+    std::set<PackageSectionDTO> failed;
+
+    auto const export_on_pool = [](AlpmDBExporter* self, PackageSectionDTO section,
+                                   std::mutex* failed_mutex,
+                                   std::set<PackageSectionDTO>* failed) -> coro::task<void> {
+        co_await self->m_export_pool.schedule();
 
-    for (auto const& section : m_dirty_sections) {
         logi("Exporter: \"{}\" export into the package manager format started",
              std::string(section));
 
-        /// TODO: We need to make this way more robust. At least a full backup
-        /// would work but maybe we can do something more smart...
-        if (!cleanup_section(section)) {
-            co_return;
-        }
+        auto const started_at = std::chrono::steady_clock::now();
 
-        auto writer = setup_alpmdb_writer(section);
+        auto const export_ok = co_await self->export_section(section);
 
-        if (!writer.has_value()) {
-            logf("Exporter: Writer cannot be created, the error is \"{}\". "
-                 "Stopping...",
-                 writer.error().what());
-            co_return;
-        }
-
-        writers.emplace(section, std::move(*writer));
+        auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_at);
 
-        co_await m_package_store.accept(
-            [this, writer = &writers.at(section)](std::string_view key,
-                                                  PackageRecord const& package) {
-                if (auto export_ok = export_package(*writer, key, package); !export_ok) {
-                    logf(fmt::format("Exporter: {}. Stopping...", export_ok.error()));
-                    return Utilities::NavigationAction::Stop;
-                }
-
-                return Utilities::NavigationAction::Next;
-            },
-            std::string(section), co_await m_uow_factory());
-        logi("Exporter: \"{}\" export finished", std::string(section));
-    }
+        if (!export_ok) {
+            logf("Exporter: \"{}\" export failed after {}ms: {}", std::string(section),
+                 elapsed.count(), export_ok.error());
 
-    m_dirty_sections.clear();
+            std::scoped_lock const lock(*failed_mutex);
+            failed->emplace(std::move(section));
+            co_return;
+        }
 
-    co_return;
-}
+        logi("Exporter: \"{}\" export finished in {}ms", std::string(section), elapsed.count());
+    };
 
-void AlpmDBExporter::add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& sections) {
-    m_dirty_sections.insert(std::make_move_iterator(sections.begin()),
-                            std::make_move_iterator(sections.end()));
-}
-// Factory function for ALPM .db archive writer
-std::expected<Archive::Writer, bxt::Error>
-    AlpmDBExporter::setup_alpmdb_writer(PackageSectionDTO const& section) {
-    Archive::Writer writer;
+    auto const started_at = std::chrono::steady_clock::now();
 
-    if (archive_write_add_filter_zstd(writer) < ARCHIVE_WARN) {
-        return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
-    }
-    if (archive_write_set_format_pax_restricted(writer) < ARCHIVE_WARN) {
-        return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
+    std::vector<coro::task<void>> tasks;
+    tasks.reserve(sections.size());
+    for (auto const& section : sections) {
+        tasks.emplace_back(export_on_pool(this, section, &failed_mutex, &failed));
     }
 
-    auto const archive_path =
-        m_box_path / std::string(section) / fmt::format("{}.db.tar.zst", section.repository);
+    co_await coro::when_all(std::move(tasks));
 
-    if (auto open_ok = writer.open_filename(archive_path); !open_ok) {
-        return std::unexpected(std::move(open_ok.error()));
+    if (m_export_files && m_file_lists_changed.exchange(false)) {
+        co_await collect_file_lists();
     }
 
-    auto const archive_link =
-        m_box_path / std::string(section) / fmt::format("{}.db", section.repository);
-
-    if (auto link_created_ok = create_relative_symlink(archive_path, archive_link);
-        !link_created_ok) {
-        return std::unexpected(link_created_ok.error());
-    }
+    logi("Exporter: {} sections exported in {}ms", sections.size(),
+         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()
+                                                               - started_at)
+             .count());
 
-    return writer;
+    co_return failed;
 }
-// Cleans up section before the export by removing all it's content
-std::expected<void, FsError> AlpmDBExporter::cleanup_section(PackageSectionDTO const& section) {
-    std::error_code ec;
 
-    std::filesystem::directory_iterator directory_iterator;
+// Cleans up the slot before the export by removing all it's content
+std::expected<void, FsError> AlpmDBExporter::cleanup_slot(std::filesystem::path const& slot_path) {
+    std::error_code ec;
 
     constexpr auto handle_error = [](auto const& ec) {
         logf("Exporter: Can't wipe the directory before the export, the "
@@ -165,14 +160,13 @@ std::expected<void, FsError> AlpmDBExporter::cleanup_section(PackageSectionDTO c
         return bxt::make_error<FsError>(ec);
     };
 
-    if (directory_iterator =
-            std::filesystem::directory_iterator(m_box_path / std::string(section), ec);
-        ec) {
+    auto directory_iterator = std::filesystem::directory_iterator(slot_path, ec);
+    if (ec) {
         return handle_error(ec);
     }
 
     for (auto const& entry : directory_iterator) {
-        if (!std::filesystem::remove_all(entry.path(), ec)) {
+        if (std::filesystem::remove_all(entry.path(), ec); ec) {
             return handle_error(ec);
         }
     }
@@ -216,72 +210,431 @@ std::expected<PackageDetails, std::string> validate_package_key(std::string_view
     return PackageDetails {section, name, *version_string, *location};
 }
 
-// Writes the contents of package description file to section's ALPM Database
-// archive
-std::expected<void, std::string> write_package_description_to_alpmdb(Archive::Writer& alpmdb_writer,
-                                                                     PackageDetails const& details,
-                                                                     PackageRecord const& package) {
-    auto const& [section, name, version, preferred_location] = details;
-    auto desc = package.descriptions.at(preferred_location).descfile.desc;
-    auto desc_path = fmt::format("{}-{}/desc", name, version);
-
-    if (auto write_ok = Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive(alpmdb_writer,
-                                                                                  desc_path, desc);
-        !write_ok) {
-        return std::unexpected(fmt::format("Failed to write description for '{}/{}-{}'.",
-                                           std::string(section), name, version));
+// Identifies what is published for a package, if it's unchanged the cached
+// fragments and links are kept as is
+std::size_t package_fingerprint(PackageRecord::Description const& description) {
+    return std::hash<std::string> {}(fmt::format(
+        "{}\n{}\n{}", description.descfile.desc, description.filepath.string(),
+        description.signature_path.value_or(std::filesystem::path {}).string()));
+}
+
+// File lists are keyed by the package checksum, or by the path of a package
+// that has none
+FileListStore::Request file_list_request(auto const& description) {
+    return {.sha256sum =
+                description.descfile.get("SHA256SUM").value_or(description.filepath.string()),
+            .filepath = description.filepath};
+}
+
+// Removes links published for a package, the ones already gone are ignored
+std::expected<void, std::string> remove_links(std::vector<std::filesystem::path> const& links) {
+    for (auto const& link : links) {
+        std::error_code ec;
+        if (std::filesystem::remove(link, ec); ec) {
+            return std::unexpected(
+                fmt::format("Failed to remove link '{}': {}", link.string(), ec.message()));
+        }
     }
     return {};
 }
 
-// Symlinks (usually pool) package and optionally it's signature to the
-// specified section
-std::expected<void, std::string> symlink_package_files(PackageDetails const& details,
-                                                       PackageRecord const& package,
-                                                       std::filesystem::path const& box_path) {
-    auto [section, name, version, preferred_location] = details;
+// Exports a section by diffing it against the previous export. The database
+// archives are assembled from cached per-package tar fragments and only the
+// links of the packages that changed since the inactive slot was published
+// are touched. The slot is then published atomically.
+coro::task<std::expected<void, std::string>>
+    AlpmDBExporter::export_section(PackageSectionDTO const& section) {
+    // States of all sections are created on construction, so concurrent
+    // exports only look them up
+    auto const state_it = m_section_states.find(section);
+    if (state_it == m_section_states.end()) {
+        co_return std::unexpected("Unknown section");
+    }
+    auto& state = state_it->second;
+
+    auto const target = 1 - state.active;
+    auto& slot = state.slots[target];
+    auto const target_path = slot_path(section, target);
+
+    if (!slot.valid) {
+        if (!cleanup_slot(target_path)) {
+            co_return std::unexpected("Slot directory can't be cleaned up");
+        }
+        slot.packages.clear();
+    }
+
+    struct ScannedPackage {
+        std::size_t fingerprint;
+        // Only kept for the packages that need new fragments or links
+        std::optional<PackageRecord::Description> description;
+    };
+
+    std::map<std::string, ScannedPackage> present;
+    std::optional<std::string> error;
+
+    auto accept_ok = co_await m_package_store.accept(
+        [&](std::string_view key, PackageRecord const& package) {
+            auto details = validate_package_key(key, package);
+            if (!details.has_value()) {
+                error = details.error();
+                return Utilities::NavigationAction::Stop;
+            }
+
+            auto const& description = package.descriptions.at(details->preferred_location);
+            auto const fingerprint = package_fingerprint(description);
 
-    auto description = package.descriptions.at(preferred_location);
+            auto const exported = state.packages.find(details->name);
+            auto const linked = slot.packages.find(details->name);
 
-    auto link_file_path = std::filesystem::absolute(box_path / std::string(section)
-                                                    / description.filepath.filename());
+            auto const up_to_date =
+                exported != state.packages.end() && exported->second.fingerprint == fingerprint
+                && linked != slot.packages.end() && linked->second.first == fingerprint;
 
-    if (auto link_ok = create_relative_symlink(description.filepath, link_file_path); !link_ok) {
-        return std::unexpected(fmt::format("Failed to link package file for '{}/{}-{}'.",
-                                           std::string(section), name, version));
+            ScannedPackage scanned {fingerprint};
+            if (!up_to_date) {
+                scanned.description = description;
+            }
+            present.emplace(details->name, std::move(scanned));
+
+            return Utilities::NavigationAction::Next;
+        },
+        std::string(section), co_await m_uow_factory());
+
+    if (!accept_ok.has_value()) {
+        co_return std::unexpected(
+            fmt::format("Packages can't be read: {}", accept_ok.error().what()));
+    }
+    if (error.has_value()) {
+        co_return std::unexpected(*error);
+    }
+
+    // Once the slot's files start changing it's only valid again when
+    // everything is written
+    slot.valid = false;
+
+    auto const removed = std::erase_if(state.packages, [&present](auto const& package) {
+        return !present.contains(package.first);
+    });
+
+    for (auto it = slot.packages.begin(); it != slot.packages.end();) {
+        auto const scanned = present.find(it->first);
+        if (scanned != present.end() && scanned->second.fingerprint == it->second.first) {
+            ++it;
+            continue;
+        }
+        if (auto remove_ok = remove_links(it->second.second); !remove_ok) {
+            co_return std::unexpected(remove_ok.error());
+        }
+        it = slot.packages.erase(it);
     }
 
+    auto const needs_fragments = [&state](std::string const& name,
+                                          ScannedPackage const& scanned) {
+        auto const exported = state.packages.find(name);
+        return exported == state.packages.end()
+               || exported->second.fingerprint != scanned.fingerprint;
+    };
+
+    std::size_t updated = 0;
+    bool replaced = removed > 0;
+    for (auto const& [name, scanned] : present) {
+        if (!scanned.description.has_value()) {
+            continue;
+        }
+
+        if (needs_fragments(name, scanned)) {
+            auto fragments = make_fragments(section, name, *scanned.description);
+            if (!fragments.has_value()) {
+                co_return std::unexpected(fragments.error());
+            }
+            fragments->fingerprint = scanned.fingerprint;
+
+            replaced = !state.packages.insert_or_assign(name, std::move(*fragments)).second
+                       || replaced;
+            ++updated;
+        }
+
+        if (!slot.packages.contains(name)) {
+            auto links = link_package(target_path, *scanned.description);
+            if (!links.has_value()) {
+                co_return std::unexpected(
+                    fmt::format("{} for '{}/{}'.", links.error(), std::string(section), name));
+            }
+
+            slot.packages.emplace(name, std::make_pair(scanned.fingerprint, std::move(*links)));
+        }
+    }
+
+    if (replaced) {
+        m_file_lists_changed = true;
+    }
+
+    // The file lists of all packages are fetched at once, so the ones that
+    // are missing are stored in a single write transaction
+    FileListStore::FileLists file_lists;
+    if (m_export_files) {
+        std::vector<FileListStore::Request> requests;
+        requests.reserve(state.packages.size());
+        for (auto const& [name, package] : state.packages) {
+            requests.emplace_back(package.files);
+        }
+
+        auto files = co_await m_file_list_store.files(requests);
+        if (!files.has_value()) {
+            co_return std::unexpected(fmt::format("Failed to list files of '{}': {}",
+                                                  std::string(section), files.error().what()));
+        }
+        file_lists = std::move(*files);
+    }
+
+    if (auto write_ok = write_databases(section, target_path, state, file_lists); !write_ok) {
+        co_return std::unexpected(write_ok.error());
+    }
+
+    slot.valid = true;
+
+    if (auto publish_ok = publish_slot(section, target); !publish_ok) {
+        co_return std::unexpected(
+            fmt::format("Slot can't be published: {}", publish_ok.error().what()));
+    }
+    state.active = target;
+
+    logi("Exporter: \"{}\" has {} packages, {} added or updated, {} removed",
+         std::string(section), state.packages.size(), updated, removed);
+
+    co_return {};
+}
+
+// Prepares the package's database fragments
+std::expected<AlpmDBExporter::ExportedPackage, std::string>
+    AlpmDBExporter::make_fragments(PackageSectionDTO const& section,
+                                   std::string const& name,
+                                   PackageRecord::Description const& description) {
+    using Utilities::AlpmDb::DatabaseUtils::make_archive_fragment;
+
+    ExportedPackage result;
+
+    auto const version = description.descfile.get("VERSION").value_or("");
+    result.directory = fmt::format("{}-{}", name, version);
+    result.files = file_list_request(description);
+
+    auto db_fragment = make_archive_fragment(fmt::format("{}/desc", result.directory),
+                                             description.descfile.desc);
+    if (!db_fragment.has_value()) {
+        return std::unexpected(fmt::format("Failed to write description for '{}/{}'.",
+                                           std::string(section), result.directory));
+    }
+    result.db_fragment = std::move(*db_fragment);
+
+    return result;
+}
+
+// Links package and optionally it's signature into the slot
+std::expected<std::vector<std::filesystem::path>, std::string>
+    AlpmDBExporter::link_package(std::filesystem::path const& slot_path,
+                                 PackageRecord::Description const& description) {
+    std::vector<std::filesystem::path> targets {description.filepath};
     if (description.signature_path.has_value()) {
-        auto link_file_path = std::filesystem::absolute(box_path / std::string(section)
-                                                        / description.signature_path->filename());
+        targets.emplace_back(*description.signature_path);
+    }
+
+    std::vector<std::filesystem::path> links;
+
+    for (auto const& target : targets) {
+        auto link = std::filesystem::absolute(slot_path / target.filename());
+
+        // A link with the same name may be left from a package that is gone
+        std::error_code ec;
+        std::filesystem::remove(link, ec);
+
+        if (auto link_ok = create_relative_symlink(target, link); !link_ok) {
+            return std::unexpected(
+                fmt::format("Failed to link '{}'", target.filename().string()));
+        }
+        links.emplace_back(std::move(link));
+    }
+
+    return links;
+}
+
+// Assembles the section's database archives from the package fragments and
+// links them under their short names
+std::expected<void, std::string>
+    AlpmDBExporter::write_databases(PackageSectionDTO const& section,
+                                    std::filesystem::path const& slot_path,
+                                    SectionState const& state,
+                                    FileListStore::FileLists const& file_lists) {
+    using Utilities::AlpmDb::DatabaseUtils::make_archive_fragment;
+
+    std::vector<std::string_view> databases {"db"};
+    if (m_export_files) {
+        databases.emplace_back("files");
+    }
 
-        if (auto link_ok = create_relative_symlink(*description.signature_path, link_file_path);
-            !link_ok) {
-            return std::unexpected(fmt::format("Failed to link signature file for '{}/{}-{}'.",
-                                               std::string(section), name, version));
+    // The files entries only live as long as the archive is written
+    std::vector<std::string> files_fragments;
+    if (m_export_files) {
+        files_fragments.reserve(state.packages.size());
+
+        for (auto const& [name, package] : state.packages) {
+            auto const files = file_lists.find(package.files.sha256sum);
+            if (files == file_lists.end()) {
+                return std::unexpected(fmt::format("Files of '{}/{}' are not listed.",
+                                                   std::string(section), package.directory));
+            }
+
+            auto files_fragment = make_archive_fragment(fmt::format("{}/files", package.directory),
+                                                        fmt::format("%FILES%\n{}", files->second));
+            if (!files_fragment.has_value()) {
+                return std::unexpected(fmt::format("Failed to write files for '{}/{}'.",
+                                                   std::string(section), package.directory));
+            }
+            files_fragments.emplace_back(package.db_fragment + *files_fragment);
         }
     }
+
+    for (auto const& database : databases) {
+        std::vector<std::string_view> fragments;
+
+        if (database == "db") {
+            fragments.reserve(state.packages.size());
+            for (auto const& [name, package] : state.packages) {
+                fragments.emplace_back(package.db_fragment);
+            }
+        } else {
+            fragments.assign(files_fragments.begin(), files_fragments.end());
+        }
+
+        auto const archive_path =
+            slot_path / fmt::format("{}.{}.tar.zst", section.repository, database);
+
+        if (auto write_ok = Utilities::AlpmDb::DatabaseUtils::write_fragments_to_archive(
+                archive_path, fragments);
+            !write_ok) {
+            return std::unexpected(fmt::format("Failed to write '{}': {}", archive_path.string(),
+                                               write_ok.error().what()));
+        }
+
+        auto const archive_link = slot_path / fmt::format("{}.{}", section.repository, database);
+
+        if (std::filesystem::is_symlink(archive_link)) {
+            continue;
+        }
+
+        if (auto link_ok = create_relative_symlink(archive_path, archive_link); !link_ok) {
+            return std::unexpected(fmt::format("Failed to link '{}': {}", archive_link.string(),
+                                               link_ok.error().what()));
+        }
+    }
+
     return {};
 }
-// Exports package into the ALPM repository format by writing it's description
-// into the .db file and symlinking package and signature files for specified
-// section
-std::expected<void, std::string> AlpmDBExporter::export_package(Archive::Writer& writer,
-                                                                std::string_view key,
-                                                                PackageRecord const& package) {
-    auto validated_details = validate_package_key(key, package);
-    if (!validated_details.has_value()) {
-        return std::unexpected(validated_details.error());
+
+coro::task<void> AlpmDBExporter::collect_file_lists() {
+    // A list stored by a concurrent export after the packages are read may
+    // be dropped as well, the next export of its section lists it again
+    phmap::flat_hash_set<std::string> live;
+
+    auto accept_ok = co_await m_package_store.accept_descriptions(
+        [&live](std::string_view, PackageDescriptionsRecord const& package) {
+            for (auto const& [location, description] : package.descriptions) {
+                live.emplace(file_list_request(description).sha256sum);
+            }
+            return Utilities::NavigationAction::Next;
+        },
+        "", co_await m_uow_factory());
+
+    if (!accept_ok.has_value()) {
+        logw("Exporter: Unused file lists can't be found: {}", accept_ok.error().what());
+        m_file_lists_changed = true;
+        co_return;
     }
 
-    auto write_result = write_package_description_to_alpmdb(writer, *validated_details, package);
-    if (!write_result.has_value()) {
-        return std::unexpected(write_result.error());
+    auto collected = co_await m_file_list_store.collect_garbage(live);
+    if (!collected.has_value()) {
+        logw("Exporter: Unused file lists can't be removed: {}", collected.error().what());
+        m_file_lists_changed = true;
+        co_return;
     }
 
-    auto file_management_result = symlink_package_files(*validated_details, package, m_box_path);
-    if (!file_management_result.has_value()) {
-        return std::unexpected(file_management_result.error());
+    if (*collected > 0) {
+        logi("Exporter: Removed the file lists of {} packages that are gone", *collected);
+    }
+}
+
+// Slots are hidden siblings of the section's path, e.g. "stable/core/.x86_64.1"
+std::filesystem::path AlpmDBExporter::slot_path(PackageSectionDTO const& section,
+                                                std::size_t slot) const {
+    auto const section_path = m_box_path / std::string(section);
+
+    return section_path.parent_path()
+           / fmt::format(".{}.{}", section_path.filename().string(), slot);
+}
+
+// Prepares the slot directories and finds out which one is published
+std::expected<void, FsError> AlpmDBExporter::setup_slots(PackageSectionDTO const& section) {
+    auto const section_path = m_box_path / std::string(section);
+    auto& state = m_section_states[section];
+
+    std::error_code ec;
+
+    if (std::filesystem::create_directories(section_path.parent_path(), ec); ec) {
+        return bxt::make_error<FsError>(ec);
+    }
+
+    if (std::filesystem::is_symlink(section_path)) {
+        auto const published = std::filesystem::read_symlink(section_path, ec);
+        if (ec) {
+            return bxt::make_error<FsError>(ec);
+        }
+        state.active = published == slot_path(section, 1).filename() ? 1 : 0;
+    } else if (std::filesystem::is_directory(section_path)) {
+        // Sections exported before the slots were introduced are plain
+        // directories, the existing export becomes the published slot
+        if (std::filesystem::remove_all(slot_path(section, 0), ec); ec) {
+            return bxt::make_error<FsError>(ec);
+        }
+        if (std::filesystem::rename(section_path, slot_path(section, 0), ec); ec) {
+            return bxt::make_error<FsError>(ec);
+        }
+        state.active = 0;
+    }
+
+    for (std::size_t slot = 0; slot < state.slots.size(); ++slot) {
+        if (std::filesystem::create_directories(slot_path(section, slot), ec); ec) {
+            return bxt::make_error<FsError>(ec);
+        }
+    }
+
+    if (!std::filesystem::is_symlink(section_path)) {
+        return publish_slot(section, state.active);
+    }
+
+    return {};
+}
+
+// Points the section's path to the slot. The new link is created aside and
+// renamed over the old one, which replaces it atomically.
+std::expected<void, FsError> AlpmDBExporter::publish_slot(PackageSectionDTO const& section,
+                                                          std::size_t slot) {
+    auto const section_path = m_box_path / std::string(section);
+    auto const temporary_link =
+        section_path.parent_path() / fmt::format(".{}.link", section_path.filename().string());
+
+    std::error_code ec;
+
+    if (std::filesystem::remove(temporary_link, ec); ec) {
+        return bxt::make_error<FsError>(ec);
+    }
+
+    std::filesystem::create_directory_symlink(slot_path(section, slot).filename(), temporary_link,
+                                              ec);
+    if (ec) {
+        return bxt::make_error<FsError>(ec);
+    }
+
+    if (std::filesystem::rename(temporary_link, section_path, ec); ec) {
+        return bxt::make_error<FsError>(ec);
     }
 
     return {};
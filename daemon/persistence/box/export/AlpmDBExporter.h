@@ -14,15 +14,21 @@
 #include "parallel_hashmap/phmap.h"
 #include "persistence/box/BoxOptions.h"
 #include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/store/FileListStore.h"
 #include "persistence/box/store/PackageStoreBase.h"
 #include "utilities/Error.h"
 #include "utilities/errors/FsError.h"
-#include "utilities/libarchive/Writer.h"
 
+#include <array>
+#include <atomic>
 #include <coro/io_scheduler.hpp>
+#include <coro/thread_pool.hpp>
 #include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace bxt::Persistence::Box {
@@ -31,27 +37,88 @@ class AlpmDBExporter : public ExporterBase {
 public:
     AlpmDBExporter(BoxOptions& box_options,
                    PackageStoreBase& package_store,
+                   FileListStore& file_list_store,
                    ReadOnlyRepositoryBase<Section>& section_repository,
                    UnitOfWorkBaseFactory& uow_factory);
 
-    coro::task<void> export_to_disk() override;
-    void add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& override) override;
+    coro::task<std::set<Core::Application::PackageSectionDTO>>
+        export_to_disk(std::set<Core::Application::PackageSectionDTO> sections) override;
 
 private:
-    std::expected<Archive::Writer, bxt::Error>
-        setup_alpmdb_writer(PackageSectionDTO const& section);
+    // Package's database entries as of the last export, reused as long as
+    // the package doesn't change. The files entries are not kept: they'd
+    // hold the file lists of the whole pool in memory, so they are made
+    // from the file list store on every export.
+    struct ExportedPackage {
+        std::size_t fingerprint = 0;
+        // The "<name>-<version>" directory of the entries
+        std::string directory;
+        std::string db_fragment;
+        FileListStore::Request files;
+    };
 
-    std::expected<void, FsError> cleanup_section(PackageSectionDTO const& section);
+    // Sections are published from two slot directories. The export brings
+    // the inactive slot up to date and then flips the section's symlink to
+    // it, so clients never see a partially written section.
+    struct Slot {
+        // False until the slot has been exported by this process or after a
+        // failed export, the next export into it then starts from scratch
+        bool valid = false;
+        // Package name to the fingerprint and links published in this slot
+        std::map<std::string, std::pair<std::size_t, std::vector<std::filesystem::path>>>
+            packages;
+    };
 
-    std::expected<void, std::string>
-        export_package(Archive::Writer& writer, std::string_view key, PackageRecord const& package);
+    struct SectionState {
+        std::map<std::string, ExportedPackage> packages;
+        std::array<Slot, 2> slots;
+        std::size_t active = 0;
+    };
+
+    coro::task<std::expected<void, std::string>> export_section(PackageSectionDTO const& section);
+
+    std::expected<ExportedPackage, std::string>
+        make_fragments(PackageSectionDTO const& section,
+                       std::string const& name,
+                       PackageRecord::Description const& description);
+
+    std::expected<std::vector<std::filesystem::path>, std::string>
+        link_package(std::filesystem::path const& slot_path,
+                     PackageRecord::Description const& description);
+
+    std::expected<void, std::string> write_databases(PackageSectionDTO const& section,
+                                                     std::filesystem::path const& slot_path,
+                                                     SectionState const& state,
+                                                     FileListStore::FileLists const& file_lists);
+
+    // Drops the stored file lists of the packages that are not in any
+    // section anymore
+    coro::task<void> collect_file_lists();
+
+    std::filesystem::path slot_path(PackageSectionDTO const& section, std::size_t slot) const;
+
+    std::expected<void, FsError> setup_slots(PackageSectionDTO const& section);
+
+    std::expected<void, FsError> publish_slot(PackageSectionDTO const& section, std::size_t slot);
+
+    std::expected<void, FsError> cleanup_slot(std::filesystem::path const& slot_path);
 
     std::filesystem::path m_box_path;
+    bool m_export_files;
     std::set<Core::Application::PackageSectionDTO> m_sections;
     PackageStoreBase& m_package_store;
+    FileListStore& m_file_list_store;
     UnitOfWorkBaseFactory& m_uow_factory;
 
-    phmap::parallel_node_hash_set<PackageSectionDTO> m_dirty_sections;
+    phmap::parallel_node_hash_map<PackageSectionDTO, SectionState> m_section_states;
+
+    // Set when an export drops or replaces packages, their file lists may
+    // be unused then
+    std::atomic<bool> m_file_lists_changed = true;
+
+    // Dirty sections are exported concurrently on this pool, each with its
+    // own read transaction and archive writers
+    coro::thread_pool m_export_pool;
 };
 
 } // namespace bxt::Persistence::Box
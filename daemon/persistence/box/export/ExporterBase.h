@@ -16,7 +16,8 @@ namespace bxt::Persistence::Box {
 struct ExporterBase {
     virtual ~ExporterBase() = default;
 
-    virtual coro::task<void> export_to_disk() = 0;
-    virtual void add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&&) = 0;
+    // Exports the sections and returns the ones whose export failed
+    virtual coro::task<std::set<Core::Application::PackageSectionDTO>>
+        export_to_disk(std::set<Core::Application::PackageSectionDTO> sections) = 0;
 };
 } // namespace bxt::Persistence::Box
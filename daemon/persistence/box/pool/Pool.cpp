@@ -28,6 +28,19 @@ std::expected<void, std::error_code> move_file(std::filesystem::path const& from
                                                std::filesystem::path const& to) {
     std::error_code ec;
 
+    // A download linked from the content store may already be the pool
+    // file, renaming one link over another of the same inode does nothing
+    if (std::filesystem::equivalent(from, to, ec) && !ec
+        && std::filesystem::weakly_canonical(from, ec) != std::filesystem::weakly_canonical(to, ec)
+        && !ec) {
+        std::filesystem::remove(from, ec);
+        if (ec) {
+            return std::unexpected(ec);
+        }
+        return {};
+    }
+    ec.clear();
+
     std::filesystem::rename(from, to, ec);
 
     // try copy + remove original
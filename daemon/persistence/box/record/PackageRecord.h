@@ -11,6 +11,8 @@
 #include "core/domain/enums/PoolLocation.h"
 #include "utilities/alpmdb/Desc.h"
 
+#include <algorithm>
+#include <array>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -73,4 +75,44 @@ struct PackageRecord {
         ar(id, is_any_architecture, descriptions);
     }
 };
+
+// A PackageRecord as it's stored, read without the file lists. Only the
+// description text and the package path of each location are kept, for
+// lookups that need a field or two of them.
+struct PackageDescriptionsRecord {
+    // Reads a string without keeping it
+    struct Skipped {
+        template<typename Archive> void load(Archive& ar) {
+            cereal::size_type size = 0;
+            ar(cereal::make_size_tag(size));
+
+            std::array<char, 4096> buffer;
+            while (size > 0) {
+                auto const chunk = std::min<cereal::size_type>(size, buffer.size());
+                ar(cereal::binary_data(buffer.data(), chunk));
+                size -= chunk;
+            }
+        }
+    };
+    struct Description {
+        std::filesystem::path filepath;
+        Utilities::AlpmDb::Desc descfile;
+
+        template<typename Archive> void load(Archive& ar) {
+            std::optional<Skipped> signature_path;
+            Skipped files;
+
+            ar(filepath, signature_path, descfile.desc, files);
+        }
+    };
+
+    PackageRecord::Id id;
+
+    bool is_any_architecture = false;
+    phmap::flat_hash_map<Core::Domain::PoolLocation, Description> descriptions;
+
+    template<typename Archive> void load(Archive& ar) {
+        ar(id, is_any_architecture, descriptions);
+    }
+};
 } // namespace bxt::Persistence::Box
@@ -0,0 +1,120 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "FileListStore.h"
+
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/log/Logging.h"
+
+#include <iterator>
+
+namespace bxt::Persistence::Box {
+
+FileListStore::FileListStore(std::shared_ptr<Utilities::LMDB::Environment> env,
+                             std::string_view const name)
+    : m_env(env)
+    , m_db(env, name) {
+}
+
+coro::task<std::expected<FileListStore::FileLists, DatabaseError>>
+    FileListStore::files(std::vector<Request> const& requests) {
+    FileLists result;
+    std::vector<Request const*> missing;
+
+    {
+        auto txn = co_await m_env->begin_ro_txn();
+
+        for (auto const& request : requests) {
+            if (result.contains(request.sha256sum)) {
+                continue;
+            }
+
+            auto cached = co_await m_db.get(txn->value, request.sha256sum);
+            if (cached.has_value()) {
+                result.emplace(request.sha256sum, std::move(*cached));
+            } else {
+                missing.emplace_back(&request);
+            }
+        }
+    }
+
+    if (missing.empty()) {
+        co_return result;
+    }
+
+    // The packages are read before the write transaction begins, so the
+    // writer lock is only held for the puts
+    FileLists listed;
+    for (auto const* request : missing) {
+        if (listed.contains(request->sha256sum)) {
+            continue;
+        }
+
+        auto files = Utilities::AlpmDb::Desc::list_files(request->filepath);
+        if (!files.has_value()) {
+            co_return bxt::make_error_with_source<DatabaseError>(
+                std::move(files.error()), DatabaseError::ErrorType::IOError);
+        }
+
+        listed.emplace(request->sha256sum, std::move(*files));
+    }
+
+    auto txn = co_await m_env->begin_rw_txn();
+
+    for (auto const& [sha256sum, files] : listed) {
+        if (auto put_ok = co_await m_db.put(txn->value, sha256sum, files); !put_ok.has_value()) {
+            co_await m_env->abort_rw_txn(*txn);
+            co_return std::unexpected(std::move(put_ok.error()));
+        }
+    }
+
+    co_await m_env->commit_rw_txn(*txn);
+
+    logd("FileListStore: files of {} packages are listed and stored", listed.size());
+
+    result.insert(std::make_move_iterator(listed.begin()), std::make_move_iterator(listed.end()));
+
+    co_return result;
+}
+
+coro::task<std::expected<std::size_t, DatabaseError>>
+    FileListStore::collect_garbage(phmap::flat_hash_set<std::string> const& live) {
+    std::vector<std::string> unused;
+
+    // Only the keys are looked at, the lists are not read
+    {
+        auto txn = co_await m_env->begin_ro_txn();
+        auto cursor = lmdb::cursor::open(txn->value, m_db.dbi());
+
+        std::string_view key;
+        std::string_view value;
+        for (auto found = cursor.get(key, value, MDB_FIRST); found;
+             found = cursor.get(key, value, MDB_NEXT)) {
+            if (!live.contains(key)) {
+                unused.emplace_back(key);
+            }
+        }
+    }
+
+    if (unused.empty()) {
+        co_return 0;
+    }
+
+    auto txn = co_await m_env->begin_rw_txn();
+
+    for (auto const& sha256sum : unused) {
+        if (auto del_ok = co_await m_db.del(txn->value, sha256sum); !del_ok.has_value()) {
+            co_await m_env->abort_rw_txn(*txn);
+            co_return std::unexpected(std::move(del_ok.error()));
+        }
+    }
+
+    co_await m_env->commit_rw_txn(*txn);
+
+    co_return unused.size();
+}
+
+} // namespace bxt::Persistence::Box
@@ -0,0 +1,57 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/errors/DatabaseError.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
+
+#include <coro/task.hpp>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+// Package file lists are only needed for the .files database, so they are
+// kept out of the package records in their own LMDB database. A list is
+// computed the first time it is requested and is keyed by the package
+// checksum, so the same file in several pool locations is listed only once.
+// Lists of packages that are gone stay until collect_garbage is called.
+class FileListStore {
+public:
+    struct Request {
+        std::string sha256sum;
+        std::filesystem::path filepath;
+    };
+
+    // File lists by the checksums of the requests
+    using FileLists = phmap::flat_hash_map<std::string, std::string>;
+
+    FileListStore(std::shared_ptr<Utilities::LMDB::Environment> env, std::string_view const name);
+
+    // Lists the files of all requested packages. The ones that are not
+    // stored yet are listed first and then stored in a single write
+    // transaction, e.g. for the first export of a whole section.
+    coro::task<std::expected<FileLists, DatabaseError>>
+        files(std::vector<Request> const& requests);
+
+    // Removes the lists whose checksums are not in live, e.g. of packages
+    // that left the pool. Returns their number.
+    coro::task<std::expected<std::size_t, DatabaseError>>
+        collect_garbage(phmap::flat_hash_set<std::string> const& live);
+
+private:
+    std::shared_ptr<Utilities::LMDB::Environment> m_env;
+    Utilities::LMDB::Database<std::string> m_db;
+};
+
+} // namespace bxt::Persistence::Box
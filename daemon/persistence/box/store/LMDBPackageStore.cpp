@@ -204,4 +204,23 @@ coro::task<std::expected<void, DatabaseError>> LMDBPackageStore::accept(
     co_return {};
 }
 
+coro::task<std::expected<void, DatabaseError>> LMDBPackageStore::accept_descriptions(
+    std::function<Utilities::NavigationAction(std::string_view key,
+                                              PackageDescriptionsRecord const& value)> visitor,
+    std::string_view prefix,
+    std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto accepted = co_await m_db.accept_as<PackageDescriptionsRecord>(lmdb_uow->txn().value,
+                                                                        visitor, prefix);
+    if (!accepted.has_value()) {
+        co_return std::unexpected(std::move(accepted.error()));
+    }
+
+    co_return {};
+}
+
 } // namespace bxt::Persistence::Box
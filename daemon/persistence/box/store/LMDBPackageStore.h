@@ -61,6 +61,12 @@ public:
             visitor,
         std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<void, DatabaseError>> accept_descriptions(
+        std::function<Utilities::NavigationAction(std::string_view key,
+                                                  PackageDescriptionsRecord const& value)> visitor,
+        std::string_view prefix,
+        std::shared_ptr<UnitOfWorkBase> uow) override;
+
 private:
     std::filesystem::path m_root_path;
     PoolBase& m_pool;
@@ -42,5 +42,12 @@ struct PackageStoreBase {
         std::function<Utilities::NavigationAction(std::string_view key, PackageRecord const& value)>
             visitor,
         std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Like accept, but the records are read without their file lists
+    virtual coro::task<std::expected<void, DatabaseError>> accept_descriptions(
+        std::function<Utilities::NavigationAction(std::string_view key,
+                                                  PackageDescriptionsRecord const& value)> visitor,
+        std::string_view prefix,
+        std::shared_ptr<UnitOfWorkBase> uow) = 0;
 };
 } // namespace bxt::Persistence::Box
@@ -0,0 +1,38 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/configuration/Configuration.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace bxt::Persistence::Box {
+
+// Writeback debounce windows, all values are in milliseconds
+struct WritebackOptions {
+    // Quiet period after the last interactive change before the export
+    int64_t delay = 5000;
+    // Quiet period after the last change made by a sync
+    int64_t sync_delay = 30000;
+    // Upper bound for how long a change stays unpublished under a steady
+    // stream of commits
+    int64_t max_staleness = 60000;
+
+    void serialize(Utilities::Configuration& config) {
+        config.set("writeback-delay", delay);
+        config.set("writeback-sync-delay", sync_delay);
+        config.set("writeback-max-staleness", max_staleness);
+    }
+    void deserialize(Utilities::Configuration const& config) {
+        delay = config.get<int64_t>("writeback-delay").value_or(delay);
+        sync_delay = config.get<int64_t>("writeback-sync-delay").value_or(sync_delay);
+        max_staleness = config.get<int64_t>("writeback-max-staleness").value_or(max_staleness);
+    }
+};
+
+} // namespace bxt::Persistence::Box
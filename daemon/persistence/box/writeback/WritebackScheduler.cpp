@@ -0,0 +1,205 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "WritebackScheduler.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <string>
+
+namespace bxt::Persistence::Box {
+
+using namespace std::chrono_literals;
+
+WritebackScheduler::WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                                       WritebackOptions& options,
+                                       ExporterBase& exporter)
+    : m_scheduler(std::move(scheduler))
+    , m_options(options)
+    , m_exporter(exporter) {
+}
+
+void WritebackScheduler::schedule(Core::Application::PackageSectionDTO const& section,
+                                  WritebackPriority priority) {
+    auto const now = Clock::now();
+
+    {
+        std::scoped_lock const lock(m_mutex);
+        auto& entry = m_sections[section];
+
+        if (entry.pending.has_value()) {
+            entry.pending->last_change = now;
+            entry.pending->priority = std::min(entry.pending->priority, priority);
+        } else {
+            entry.pending = Changes {.first_change = now, .last_change = now, .priority = priority};
+        }
+
+        if (entry.running) {
+            return;
+        }
+        entry.running = true;
+    }
+
+    m_scheduler->schedule(run(section));
+}
+
+bool WritebackScheduler::scheduled() const {
+    std::scoped_lock const lock(m_mutex);
+
+    return std::ranges::any_of(m_sections, [](auto const& entry) { return entry.second.running; });
+}
+
+WritebackScheduler::Stats WritebackScheduler::stats() const {
+    auto const now = Clock::now();
+
+    Stats result {.exported = m_exported, .failed = m_failed};
+
+    std::scoped_lock const lock(m_mutex);
+
+    for (auto const& [section, entry] : m_sections) {
+        // The oldest unpublished change is in the running export if there is
+        // one, changes made after it started are pending for the next one
+        auto const& oldest = entry.exporting.has_value() ? entry.exporting : entry.pending;
+        if (!oldest.has_value()) {
+            continue;
+        }
+
+        auto const age =
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - oldest->first_change);
+
+        result.pending.emplace_back(PendingSection {
+            .section = section, .priority = oldest->priority, .oldest_change_age = age});
+        result.oldest_change_age = std::max(result.oldest_change_age, age);
+    }
+
+    return result;
+}
+
+void WritebackScheduler::log_stats() const {
+    auto const stats = this->stats();
+
+    logd("Writeback: {} exported, {} failed", stats.exported, stats.failed);
+    if (stats.pending.empty()) {
+        return;
+    }
+
+    logi("Writeback: {} sections pending, the oldest change is {}ms old", stats.pending.size(),
+         stats.oldest_change_age.count());
+    for (auto const& pending : stats.pending) {
+        logd("Writeback: \"{}\" has changes pending for {}ms", std::string(pending.section),
+             pending.oldest_change_age.count());
+    }
+}
+
+WritebackScheduler::Clock::time_point
+    WritebackScheduler::deadline(Changes const& changes) const {
+    auto const delay = std::chrono::milliseconds(
+        changes.priority == WritebackPriority::Interactive ? m_options.delay
+                                                           : m_options.sync_delay);
+
+    return std::max(changes.not_before,
+                    std::min(changes.last_change + delay,
+                             changes.first_change
+                                 + std::chrono::milliseconds(m_options.max_staleness)));
+}
+
+coro::task<void> WritebackScheduler::run(Core::Application::PackageSectionDTO section) {
+    while (true) {
+        Changes changes;
+
+        // Wait until the section had no changes for the debounce window or
+        // its oldest change got too stale
+        while (true) {
+            Clock::time_point due;
+            {
+                std::scoped_lock const lock(m_mutex);
+                auto& entry = m_sections[section];
+
+                due = deadline(*entry.pending);
+                if (Clock::now() >= due) {
+                    changes = *entry.pending;
+                    entry.exporting = changes;
+                    entry.pending.reset();
+                    break;
+                }
+            }
+
+            co_await m_scheduler->schedule_after(
+                std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now()) + 1ms);
+        }
+
+        auto const interactive = changes.priority == WritebackPriority::Interactive;
+
+        // Bulk sync exports give way to interactive ones as long as they are
+        // not stale yet
+        while (!interactive && m_interactive_exports > 0
+               && Clock::now()
+                      < changes.first_change + std::chrono::milliseconds(m_options.max_staleness)) {
+            co_await m_scheduler->schedule_after(100ms);
+        }
+
+        if (interactive) {
+            ++m_interactive_exports;
+        }
+
+        auto const failed = co_await m_exporter.export_to_disk({section});
+
+        if (interactive) {
+            --m_interactive_exports;
+        }
+
+        auto const age = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - changes.first_change);
+
+        bool finished = false;
+        {
+            std::scoped_lock const lock(m_mutex);
+            auto& entry = m_sections[section];
+            entry.exporting.reset();
+
+            if (failed.empty()) {
+                ++m_exported;
+                logi("Writeback: \"{}\" published {}ms after its oldest change",
+                     std::string(section), age.count());
+            } else {
+                ++m_failed;
+                logw("Writeback: \"{}\" export failed, retrying in {}ms", std::string(section),
+                     m_options.delay);
+
+                // Keep the age of the unpublished changes but don't retry
+                // before the delay passes
+                auto const now = Clock::now();
+                auto const not_before = now + std::chrono::milliseconds(m_options.delay);
+
+                if (entry.pending.has_value()) {
+                    entry.pending->first_change =
+                        std::min(entry.pending->first_change, changes.first_change);
+                    entry.pending->priority = std::min(entry.pending->priority, changes.priority);
+                    entry.pending->not_before = not_before;
+                } else {
+                    entry.pending = Changes {.first_change = changes.first_change,
+                                             .last_change = now,
+                                             .priority = changes.priority,
+                                             .not_before = not_before};
+                }
+            }
+
+            if (!entry.pending.has_value()) {
+                entry.running = false;
+                finished = true;
+            }
+        }
+
+        log_stats();
+
+        if (finished) {
+            co_return;
+        }
+    }
+}
+
+} // namespace bxt::Persistence::Box
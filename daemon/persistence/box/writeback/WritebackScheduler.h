@@ -7,54 +7,88 @@
 #pragma once
 
 #include "core/application/dtos/PackageSectionDTO.h"
-#include "utilities/log/Logging.h"
+#include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/writeback/WritebackOptions.h"
 
+#include <atomic>
 #include <chrono>
 #include <coro/io_scheduler.hpp>
-#include <coro/mutex.hpp>
+#include <coro/task.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <vector>
 
 namespace bxt::Persistence::Box {
-class WritebackScheduler {
-public:
-    explicit WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler)
-        : m_scheduler(std::move(scheduler)) {
-    }
-
-    coro::task<void> schedule(coro::task<void> task) {
-        auto const lock = co_await m_mutex.lock();
 
-        if (m_scheduled) {
-            co_return;
-        }
+enum class WritebackPriority { Interactive, Sync };
 
-        this->m_scheduled = true;
+// Debounces exports per section. A section is exported once it had no
+// changes for the delay of its priority, or when its oldest unpublished
+// change reaches the maximum staleness. Each section has at most one export
+// running at a time, while different sections are exported independently.
+class WritebackScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
 
-        auto scheduled_task = [](auto* self, coro::task<void> task) -> coro::task<void> {
-            using namespace std::chrono_literals;
+    struct PendingSection {
+        Core::Application::PackageSectionDTO section;
+        WritebackPriority priority;
+        std::chrono::milliseconds oldest_change_age;
+    };
 
-            co_await self->m_scheduler->schedule_after(5s);
+    struct Stats {
+        std::vector<PendingSection> pending;
+        std::chrono::milliseconds oldest_change_age {0};
+        uint64_t exported = 0;
+        uint64_t failed = 0;
+    };
 
-            auto const lock = co_await self->m_mutex.lock();
+    WritebackScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                       WritebackOptions& options,
+                       ExporterBase& exporter);
 
-            co_await task;
+    void schedule(Core::Application::PackageSectionDTO const& section,
+                  WritebackPriority priority = WritebackPriority::Interactive);
 
-            self->m_scheduled = false;
+    bool scheduled() const;
 
-            co_return;
-        }(this, std::move(task));
+    Stats stats() const;
 
-        m_scheduler->schedule(std::move(scheduled_task));
+private:
+    struct Changes {
+        Clock::time_point first_change;
+        Clock::time_point last_change;
+        WritebackPriority priority;
+        // Set when retrying a failed export so it's not retried right away
+        Clock::time_point not_before {};
+    };
+
+    struct SectionEntry {
+        // Changes not yet picked up by an export
+        std::optional<Changes> pending;
+        // Changes the running export is publishing
+        std::optional<Changes> exporting;
+        bool running = false;
+    };
+
+    coro::task<void> run(Core::Application::PackageSectionDTO section);
+    // Logs the pending sections and the age of their oldest changes after
+    // every export
+    void log_stats() const;
+
+    Clock::time_point deadline(Changes const& changes) const;
 
-        co_return;
-    }
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+    WritebackOptions& m_options;
+    ExporterBase& m_exporter;
 
-    bool scheduled() {
-        return m_scheduled;
-    }
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<Core::Application::PackageSectionDTO, SectionEntry> m_sections;
 
-private:
-    std::shared_ptr<coro::io_scheduler> m_scheduler;
-    coro::mutex m_mutex;
-    std::atomic<bool> m_scheduled = false;
+    std::atomic<int64_t> m_interactive_exports = 0;
+    std::atomic<uint64_t> m_exported = 0;
+    std::atomic<uint64_t> m_failed = 0;
 };
 } // namespace bxt::Persistence::Box
@@ -10,6 +10,7 @@
 #include "utilities/lmdb/Environment.h"
 #include "utilities/locked.h"
 
+#include <coro/sync_wait.hpp>
 #include <coro/task.hpp>
 #include <cstddef>
 #include <memory>
@@ -21,7 +22,13 @@ public:
         : m_env(std::move(env)) {
     }
 
-    virtual ~LmdbUnitOfWork() = default;
+    // An unfinished write transaction is aborted on the writer thread, the
+    // lmdb::txn destructor would abort it on whatever thread this is
+    virtual ~LmdbUnitOfWork() {
+        if (m_rw && m_txn && m_txn->value.handle() != nullptr) {
+            coro::sync_wait(m_env->abort_rw_txn(*m_txn));
+        }
+    }
 
     coro::task<Result<void>> commit_async() override {
         for (auto const& [name, hook] : m_hooks) {
@@ -29,19 +36,32 @@ public:
         }
         m_hooks.clear();
 
-        m_txn->value.commit();
+        // Release the environment lock right away instead of waiting for
+        // the unit of work to be destroyed
+        if (m_rw) {
+            co_await m_env->commit_rw_txn(*m_txn);
+        } else {
+            m_txn->value.commit();
+            m_txn->lock.reset();
+        }
         co_return {};
     }
 
     coro::task<Result<void>> rollback_async() override {
         m_hooks = {};
 
-        m_txn->value.abort();
+        if (m_rw) {
+            co_await m_env->abort_rw_txn(*m_txn);
+        } else {
+            m_txn->value.abort();
+            m_txn->lock.reset();
+        }
         co_return {};
     }
 
     coro::task<Result<void>> begin_async() override {
         m_txn = co_await m_env->begin_rw_txn();
+        m_rw = true;
         co_return {};
     }
 
@@ -68,6 +88,7 @@ private:
     std::map<HookKeyType, std::function<void()>> m_hooks;
     std::shared_ptr<Utilities::LMDB::Environment> m_env;
     std::unique_ptr<Utilities::locked<lmdb::txn>> m_txn;
+    bool m_rw = false;
 };
 
 struct LmdbUnitOfWorkFactory : public Core::Domain::UnitOfWorkBaseFactory {
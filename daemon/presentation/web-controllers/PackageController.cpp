@@ -44,6 +44,15 @@ drogon::Task<HttpResponsePtr> PackageController::sync(drogon::HttpRequestPtr req
 
     co_return HttpResponse::newHttpResponse();
 }
+
+drogon::Task<HttpResponsePtr> PackageController::sync_plan(drogon::HttpRequestPtr req) {
+    BXT_JWT_CHECK_PERMISSIONS("packages.sync", req)
+
+    auto const plans = co_await m_sync_service.plan_all();
+
+    co_return drogon_helpers::make_json_response(plans);
+}
+
 drogon::Task<drogon::HttpResponsePtr>
     PackageController::commit_transaction(drogon::HttpRequestPtr req) {
     MultiPartParser file_upload;
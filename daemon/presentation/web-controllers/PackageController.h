@@ -41,6 +41,8 @@ public:
 
     BXT_JWT_ADD_METHOD_TO(PackageController::sync, "/api/packages/sync", drogon::Post);
 
+    BXT_JWT_ADD_METHOD_TO(PackageController::sync_plan, "/api/sync/plan", drogon::Post);
+
     BXT_JWT_ADD_METHOD_TO(PackageController::snap_branch,
                           "/api/packages/snap/branch",
                           drogon::Post);
@@ -51,6 +53,8 @@ public:
 
     drogon::Task<drogon::HttpResponsePtr> sync(drogon::HttpRequestPtr req);
 
+    drogon::Task<drogon::HttpResponsePtr> sync_plan(drogon::HttpRequestPtr req);
+
     drogon::Task<drogon::HttpResponsePtr> commit_transaction(drogon::HttpRequestPtr req);
 
     drogon::Task<drogon::HttpResponsePtr> get_packages(drogon::HttpRequestPtr req,
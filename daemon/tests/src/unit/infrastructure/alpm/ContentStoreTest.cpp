@@ -0,0 +1,69 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/ContentStore.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace bxt::Infrastructure;
+
+namespace {
+std::string read_file(std::filesystem::path const& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+TEST_CASE("ContentStore", "[infrastructure][alpm]") {
+    auto const directory = std::filesystem::temp_directory_path() / "bxt-content-store-test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "stable");
+    std::filesystem::create_directories(directory / "unstable");
+
+    constexpr auto hello_sha256 =
+        "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824";
+
+    auto const downloaded = directory / "stable" / "package.pkg.tar.zst";
+    auto const target = directory / "unstable" / "package.pkg.tar.zst";
+
+    std::ofstream(downloaded) << "hello";
+
+    ContentStore store(directory / ".content");
+
+    SECTION("A known file is linked instead of downloaded") {
+        store.add(hello_sha256, downloaded);
+
+        REQUIRE(store.link_to(hello_sha256, target));
+        REQUIRE(read_file(target) == "hello");
+        REQUIRE(store.take_bytes_saved() == 5);
+        REQUIRE(store.take_bytes_saved() == 0);
+    }
+
+    SECTION("The blob outlives a moved or removed file") {
+        store.add(hello_sha256, downloaded);
+
+        std::filesystem::rename(downloaded, directory / "moved.pkg.tar.zst");
+        REQUIRE(store.collect_garbage() == 0);
+
+        std::filesystem::remove(directory / "moved.pkg.tar.zst");
+        REQUIRE(store.collect_garbage() == 1);
+        REQUIRE_FALSE(store.link_to(hello_sha256, target));
+    }
+
+    SECTION("Unknown and malformed sums are not linked") {
+        REQUIRE_FALSE(store.link_to(hello_sha256, target));
+
+        store.add("../../escape", downloaded);
+        REQUIRE_FALSE(store.link_to("../../escape", target));
+        REQUIRE_FALSE(std::filesystem::exists(target));
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,145 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/ContentStore.h"
+#include "infrastructure/alpm/DownloadCache.h"
+#include "infrastructure/alpm/FileHashCache.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace bxt::Infrastructure;
+
+namespace {
+void write_file(std::filesystem::path const& path, std::size_t size) {
+    std::ofstream(path, std::ios::binary) << std::string(size, 'x');
+}
+} // namespace
+
+TEST_CASE("DownloadCache", "[infrastructure][alpm]") {
+    auto const directory = std::filesystem::temp_directory_path() / "bxt-download-cache-test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "stable");
+    std::filesystem::create_directories(directory / ".content");
+
+    auto const first = directory / "stable" / "first.pkg.tar.zst";
+    auto const second = directory / "stable" / "second.pkg.tar.zst";
+    auto const third = directory / "stable" / "third.pkg.tar.zst";
+
+    FileHashCache hashes(directory / ".hash-cache");
+    ContentStore content(directory / ".content");
+
+    SECTION("The least recently used files are evicted first") {
+        DownloadCache cache(directory, 250, hashes, content);
+
+        write_file(first, 100);
+        write_file(first.string() + ".sig", 10);
+        cache.record_miss(first);
+        write_file(second, 100);
+        cache.record_miss(second);
+        write_file(third, 100);
+        cache.record_miss(third);
+
+        // The first one is used again, so the second one goes
+        cache.record_hit(first);
+
+        REQUIRE(cache.evict() == 1);
+        REQUIRE(std::filesystem::exists(first));
+        REQUIRE(std::filesystem::exists(first.string() + ".sig"));
+        REQUIRE_FALSE(std::filesystem::exists(second));
+        REQUIRE(std::filesystem::exists(third));
+
+        auto const stats = cache.stats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 3);
+        REQUIRE(stats.evictions == 1);
+        REQUIRE(stats.evicted_bytes == 100);
+        REQUIRE(stats.files == 2);
+        REQUIRE(stats.bytes == 200);
+    }
+
+    SECTION("Files shared with the pool are neither counted nor evicted") {
+        DownloadCache cache(directory, 50, hashes, content);
+
+        write_file(first, 100);
+        std::filesystem::create_hard_link(first, directory / ".content" / "blob");
+        cache.record_miss(first);
+
+        REQUIRE(cache.evict() == 0);
+        REQUIRE(std::filesystem::exists(first));
+        REQUIRE(cache.stats().bytes == 0);
+
+        // Once the pool lets go of it, it's an ordinary cached file
+        std::filesystem::remove(directory / ".content" / "blob");
+        REQUIRE(cache.evict() == 1);
+        REQUIRE_FALSE(std::filesystem::exists(first));
+    }
+
+    SECTION("Files only the content store links to are evicted with their blob") {
+        auto const sha256sum = std::string(64, 'a');
+        auto const blob = directory / ".content" / "aa" / sha256sum;
+
+        write_file(first, 100);
+        hashes.store(first, sha256sum);
+        content.add(sha256sum, first);
+        REQUIRE(std::filesystem::equivalent(first, blob));
+
+        DownloadCache cache(directory, 50, hashes, content);
+        REQUIRE(cache.stats().bytes == 100);
+
+        REQUIRE(cache.evict() == 1);
+        REQUIRE_FALSE(std::filesystem::exists(first));
+        REQUIRE_FALSE(std::filesystem::exists(blob));
+    }
+
+    SECTION("Files the pool links to besides the content store are kept") {
+        auto const sha256sum = std::string(64, 'a');
+        auto const blob = directory / ".content" / "aa" / sha256sum;
+
+        write_file(first, 100);
+        hashes.store(first, sha256sum);
+        content.add(sha256sum, first);
+        std::filesystem::create_directories(directory / ".pool");
+        std::filesystem::create_hard_link(first, directory / ".pool" / "first.pkg.tar.zst");
+
+        DownloadCache cache(directory, 50, hashes, content);
+        cache.record_hit(first);
+
+        REQUIRE(cache.evict() == 0);
+        REQUIRE(std::filesystem::exists(first));
+        REQUIRE(std::filesystem::exists(blob));
+    }
+
+    SECTION("Files moved away are forgotten") {
+        DownloadCache cache(directory, 50, hashes, content);
+
+        write_file(first, 100);
+        cache.record_miss(first);
+        std::filesystem::rename(first, directory / "moved.pkg.tar.zst");
+
+        REQUIRE(cache.evict() == 0);
+        REQUIRE(cache.stats().files == 0);
+    }
+
+    SECTION("Existing files are found on start") {
+        write_file(first, 100);
+        write_file(second, 100);
+        write_file(directory / "stable" / ".index.db", 100);
+        write_file(directory / "stable" / "third.pkg.tar.zst.part", 100);
+        write_file(directory / ".content" / "blob", 100);
+
+        DownloadCache cache(directory, 0, hashes, content);
+
+        auto const stats = cache.stats();
+        REQUIRE(stats.files == 2);
+        REQUIRE(stats.bytes == 200);
+        REQUIRE(cache.evict() == 0);
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,162 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/ExcludeMatcher.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace bxt::Infrastructure;
+
+namespace {
+// Modelled after the exclude lists used to sync Manjaro branches from Arch:
+// packages replaced by Manjaro's own, kernels and their modules, branding
+std::vector<std::string> const manjaro_exclude_list {
+    "linux",
+    "linux-headers",
+    "linux-docs",
+    "linux-lts",
+    "linux-lts-headers",
+    "linux-zen",
+    "linux-zen-headers",
+    "linux-hardened",
+    "linux-hardened-headers",
+    "linux-firmware",
+    "linux[0-9]+",
+    "linux[0-9]+-headers",
+    "linux[0-9]+-.*",
+    "nvidia",
+    "nvidia-lts",
+    "nvidia-dkms",
+    "nvidia-utils",
+    "lib32-nvidia-utils",
+    "nvidia-[0-9]+xx-.*",
+    "virtualbox-host-modules-arch",
+    "broadcom-wl",
+    "r8168",
+    "acpi_call",
+    "bbswitch",
+    "tp_smapi",
+    "pacman",
+    "pacman-mirrorlist",
+    "archlinux-keyring",
+    "archlinux-mirrorlist",
+    "archlinux-appstream-data",
+    "filesystem",
+    "lsb-release",
+    "grub",
+    "mkinitcpio",
+    "systemd-boot-.*",
+    "plymouth.*",
+    "manjaro-.*",
+    ".*-manjaro",
+    "arch-install-scripts",
+    "(kde|gnome|xfce)-wallpapers",
+};
+
+std::vector<std::string> package_names(std::size_t count) {
+    std::vector<std::string> const stems {"lib", "python-", "perl-", "ruby-", "haskell-",
+                                          "qt6-", "kde-",   "gnome-", "xfce4-", "linux"};
+
+    std::vector<std::string> names;
+    names.reserve(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        names.emplace_back(fmt::format("{}package{}", stems[i % stems.size()], i));
+    }
+
+    // A few names that are actually excluded
+    names.emplace_back("linux");
+    names.emplace_back("linux61-nvidia");
+    names.emplace_back("manjaro-release");
+
+    return names;
+}
+
+bool matches_naively(std::vector<std::string> const& patterns, std::string const& name) {
+    for (auto const& pattern : patterns) {
+        if (std::regex_match(name, std::regex(pattern))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+} // namespace
+
+TEST_CASE("ExcludeMatcher", "[infrastructure][alpm]") {
+    ExcludeMatcher const matcher(manjaro_exclude_list);
+
+    SECTION("Plain names match exactly") {
+        REQUIRE(matcher.matches("linux"));
+        REQUIRE(matcher.matches("pacman"));
+        REQUIRE_FALSE(matcher.matches("linux-api-headers"));
+        REQUIRE_FALSE(matcher.matches("pacman-contrib"));
+    }
+
+    SECTION("Prefix and suffix patterns") {
+        REQUIRE(matcher.matches("manjaro-release"));
+        REQUIRE(matcher.matches("plymouth"));
+        REQUIRE(matcher.matches("grub-theme-manjaro"));
+        REQUIRE_FALSE(matcher.matches("xmanjaro-release"));
+    }
+
+    SECTION("Regular expressions match the whole name") {
+        REQUIRE(matcher.matches("linux61"));
+        REQUIRE(matcher.matches("linux61-headers"));
+        REQUIRE(matcher.matches("nvidia-470xx-utils"));
+        REQUIRE(matcher.matches("kde-wallpapers"));
+        REQUIRE_FALSE(matcher.matches("linuxx"));
+        REQUIRE_FALSE(matcher.matches("kde-wallpapers-extra"));
+    }
+
+    SECTION("Invalid patterns are ignored") {
+        ExcludeMatcher const with_invalid(std::vector<std::string> {"(unclosed", "nvidia-.*x"});
+
+        REQUIRE(with_invalid.matches("nvidia-470xx"));
+        REQUIRE_FALSE(with_invalid.matches("(unclosed"));
+    }
+
+    SECTION("Agrees with matching every pattern separately") {
+        for (auto const& name : package_names(500)) {
+            REQUIRE(matcher.matches(name) == matches_naively(manjaro_exclude_list, name));
+        }
+    }
+
+    SECTION("An empty list matches nothing") {
+        ExcludeMatcher const empty;
+
+        REQUIRE(empty.empty());
+        REQUIRE_FALSE(empty.matches("linux"));
+    }
+}
+
+TEST_CASE("ExcludeMatcher exclude list", "[.][benchmark][infrastructure][alpm]") {
+    // About the size of Arch's core, extra and multilib together
+    auto const names = package_names(15000);
+
+    BENCHMARK("precompiled matcher") {
+        ExcludeMatcher const matcher(manjaro_exclude_list);
+
+        std::size_t excluded = 0;
+        for (auto const& name : names) {
+            excluded += matcher.matches(name);
+        }
+        return excluded;
+    };
+
+    BENCHMARK("regex per pattern and name") {
+        std::size_t excluded = 0;
+        for (auto const& name : names) {
+            excluded += matches_naively(manjaro_exclude_list, name);
+        }
+        return excluded;
+    };
+}
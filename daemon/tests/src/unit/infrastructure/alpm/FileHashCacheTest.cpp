@@ -0,0 +1,99 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/FileHashCache.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+
+using namespace bxt::Infrastructure;
+
+TEST_CASE("FileHashCache", "[infrastructure][alpm]") {
+    auto const directory = std::filesystem::temp_directory_path() / "bxt-file-hash-cache-test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    auto const cache_path = directory / ".hash-cache";
+    auto const package_path = directory / "package with spaces.pkg.tar.zst";
+
+    constexpr auto hello_sha256 =
+        "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824";
+
+    std::ofstream(package_path) << "hello";
+
+    SECTION("Hashes survive a restart") {
+        {
+            FileHashCache cache(cache_path);
+            REQUIRE_FALSE(cache.sha256sum(package_path).has_value());
+
+            REQUIRE(cache.hash(package_path) == hello_sha256);
+            REQUIRE(cache.sha256sum(package_path) == hello_sha256);
+        }
+
+        FileHashCache cache(cache_path);
+        REQUIRE(cache.size() == 1);
+        REQUIRE(cache.sha256sum(package_path) == hello_sha256);
+    }
+
+    SECTION("Stored sums are used without reading the file") {
+        FileHashCache cache(cache_path);
+        cache.store(package_path, "stored");
+
+        REQUIRE(cache.hash(package_path) == "stored");
+    }
+
+    SECTION("A changed file is hashed again") {
+        {
+            FileHashCache cache(cache_path);
+            cache.store(package_path, "stale");
+        }
+
+        std::ofstream(package_path, std::ios::app) << "changed";
+
+        FileHashCache cache(cache_path);
+        REQUIRE(cache.size() == 0);
+        REQUIRE_FALSE(cache.sha256sum(package_path).has_value());
+    }
+
+    SECTION("Removed files are dropped on load") {
+        {
+            FileHashCache cache(cache_path);
+            cache.hash(package_path);
+        }
+
+        std::filesystem::remove(package_path);
+
+        REQUIRE(FileHashCache(cache_path).size() == 0);
+    }
+
+    SECTION("Compacting drops the entries of removed files") {
+        FileHashCache cache(cache_path);
+        cache.hash(package_path);
+        cache.store(package_path, "stored");
+
+        std::filesystem::remove(package_path);
+        cache.compact();
+
+        REQUIRE(cache.size() == 0);
+        REQUIRE(std::filesystem::file_size(cache_path) == 0);
+
+        // Entries stored after the compaction are still kept
+        std::ofstream(package_path) << "hello";
+        cache.hash(package_path);
+
+        REQUIRE(FileHashCache(cache_path).size() == 1);
+    }
+
+    SECTION("A truncated line is ignored") {
+        std::ofstream(cache_path) << "hash 5";
+
+        FileHashCache cache(cache_path);
+        REQUIRE(cache.size() == 0);
+    }
+
+    std::filesystem::remove_all(directory);
+}
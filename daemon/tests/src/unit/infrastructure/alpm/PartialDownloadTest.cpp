@@ -0,0 +1,89 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/PartialDownload.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace bxt::Infrastructure;
+
+namespace {
+std::string read_file(std::filesystem::path const& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+TEST_CASE("PartialDownload", "[infrastructure][alpm]") {
+    auto const directory = std::filesystem::temp_directory_path() / "bxt-partial-download-test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    auto const target = directory / "package.pkg.tar.zst";
+
+    SECTION("An interrupted download is resumed") {
+        {
+            PartialDownload partial(target, "https://mirror/package", "hash");
+            REQUIRE(partial.resumable_size() == 0);
+            REQUIRE(partial.begin(false));
+            REQUIRE(partial.write("first ", 6));
+        }
+
+        PartialDownload partial(target, "https://mirror/package", "hash");
+        REQUIRE(partial.resumable_size() == 6);
+        REQUIRE(partial.begin(true));
+        REQUIRE(partial.write("second", 6));
+        REQUIRE(partial.finish());
+
+        REQUIRE(read_file(target) == "first second");
+        REQUIRE(partial.received_sha256sum()
+                == "92088ec140fc553e4b1ede202edccb65a807bbf8a38d765a3ad38013c0f13688");
+        REQUIRE_FALSE(std::filesystem::exists(partial.part_path()));
+        REQUIRE_FALSE(std::filesystem::exists(target.string() + ".part.meta"));
+    }
+
+    SECTION("A partial file of another download is discarded") {
+        {
+            PartialDownload partial(target, "https://mirror/package", "hash");
+            REQUIRE(partial.begin(false));
+            REQUIRE(partial.write("stale", 5));
+        }
+
+        PartialDownload partial(target, "https://mirror/package", "other-hash");
+        REQUIRE(partial.resumable_size() == 0);
+        REQUIRE_FALSE(std::filesystem::exists(partial.part_path()));
+    }
+
+    SECTION("Restarting overwrites the partial file") {
+        {
+            PartialDownload partial(target, "https://mirror/package", "hash");
+            REQUIRE(partial.begin(false));
+            REQUIRE(partial.write("stale", 5));
+        }
+
+        PartialDownload partial(target, "https://mirror/package", "hash");
+        REQUIRE(partial.begin(false));
+        REQUIRE(partial.write("fresh", 5));
+        REQUIRE(partial.finish());
+
+        REQUIRE(read_file(target) == "fresh");
+        REQUIRE(partial.received_sha256sum()
+                == "d098ab5e44b9aabb755f76d806598f43573c662b35e4a2eab1e312ec9ad195e2");
+    }
+
+    SECTION("Content-Range is parsed") {
+        REQUIRE(PartialDownload::content_range_start("bytes 100-199/200") == 100);
+        REQUIRE(PartialDownload::content_range_start("bytes 0-0/*") == 0);
+        REQUIRE_FALSE(PartialDownload::content_range_start("bytes */200").has_value());
+        REQUIRE_FALSE(PartialDownload::content_range_start("items 1-2/3").has_value());
+    }
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,47 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/record/PackageRecord.h"
+#include "utilities/lmdb/CerealSerializer.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+using namespace bxt::Persistence::Box;
+using bxt::Core::Domain::PoolLocation;
+using bxt::Utilities::LMDB::CerealSerializer;
+
+TEST_CASE("PackageRecord", "[persistence][box]") {
+    SECTION("Stored records can be read with the descriptions only") {
+        PackageRecord record {
+            .id = {.section = {.branch = "stable", .repository = "core", .architecture = "x86_64"},
+                   .name = "bash"},
+            .is_any_architecture = true};
+        record.descriptions[PoolLocation::Sync] = {
+            .filepath = "/pool/bash-5.2-1-x86_64.pkg.tar.zst",
+            .signature_path = "/pool/bash-5.2-1-x86_64.pkg.tar.zst.sig",
+            .descfile = {.desc = "%NAME%\nbash\n\n%VERSION%\n5.2-1\n\n",
+                         .files = std::string(10000, 'f')}};
+        record.descriptions[PoolLocation::Overlay] = {
+            .filepath = "/pool/bash-5.2-2-x86_64.pkg.tar.zst",
+            .descfile = {.desc = "%NAME%\nbash\n\n%VERSION%\n5.2-2\n\n"}};
+
+        auto const stored = CerealSerializer<PackageRecord>::serialize(record);
+        REQUIRE(stored.has_value());
+
+        auto const read = CerealSerializer<PackageDescriptionsRecord>::deserialize(*stored);
+        REQUIRE(read.has_value());
+
+        REQUIRE(read->id.to_string() == record.id.to_string());
+        REQUIRE(read->is_any_architecture);
+        REQUIRE(read->descriptions.size() == 2);
+        REQUIRE(read->descriptions.at(PoolLocation::Sync).descfile.get("VERSION") == "5.2-1");
+        REQUIRE(read->descriptions.at(PoolLocation::Sync).descfile.files.empty());
+        REQUIRE(read->descriptions.at(PoolLocation::Sync).filepath
+                == "/pool/bash-5.2-1-x86_64.pkg.tar.zst");
+        REQUIRE(read->descriptions.at(PoolLocation::Overlay).descfile.get("VERSION") == "5.2-2");
+    }
+}
@@ -0,0 +1,58 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/store/FileListStore.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+using namespace bxt::Persistence::Box;
+using bxt::Utilities::LMDB::Database;
+using bxt::Utilities::LMDB::Environment;
+
+TEST_CASE("FileListStore", "[persistence][box]") {
+    auto const path = std::filesystem::temp_directory_path() / "bxt-file-list-store-test";
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+
+    auto environment = std::make_shared<Environment>(coro::io_scheduler::make_shared());
+    environment->set_concurrent_reads(true);
+    environment->env().set_max_dbs(4);
+    environment->env().open(path.c_str(), environment->open_flags(), 0664);
+
+    FileListStore store(environment, "files");
+
+    // Lists stored earlier, as if their packages were listed by an export
+    Database<std::string> lists(environment, "files");
+    {
+        auto txn = coro::sync_wait(environment->begin_rw_txn());
+        REQUIRE(coro::sync_wait(lists.put(txn->value, "live", "usr/bin/live\n")).has_value());
+        REQUIRE(coro::sync_wait(lists.put(txn->value, "gone", "usr/bin/gone\n")).has_value());
+        coro::sync_wait(environment->commit_rw_txn(*txn));
+    }
+
+    SECTION("Lists of packages that are gone are collected") {
+        auto const collected = coro::sync_wait(store.collect_garbage({"live"}));
+        REQUIRE(collected.has_value());
+        REQUIRE(*collected == 1);
+
+        auto txn = coro::sync_wait(environment->begin_ro_txn());
+        REQUIRE(coro::sync_wait(lists.get(txn->value, "live")).has_value());
+        REQUIRE_FALSE(coro::sync_wait(lists.get(txn->value, "gone")).has_value());
+    }
+
+    SECTION("Stored lists are returned without reading the packages") {
+        auto const files = coro::sync_wait(
+            store.files({{.sha256sum = "live", .filepath = path / "missing.pkg.tar.zst"}}));
+        REQUIRE(files.has_value());
+        REQUIRE(files->at("live") == "usr/bin/live\n");
+    }
+
+    std::filesystem::remove_all(path);
+}
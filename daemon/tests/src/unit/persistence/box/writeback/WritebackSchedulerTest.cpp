@@ -0,0 +1,93 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/writeback/WritebackScheduler.h"
+#include "utilities/scheduler/SchedulerOptions.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace bxt::Persistence::Box;
+using namespace std::chrono_literals;
+
+namespace {
+struct RecordingExporter : public ExporterBase {
+    coro::task<std::set<PackageSectionDTO>>
+        export_to_disk(std::set<PackageSectionDTO> sections) override {
+        std::scoped_lock const lock(mutex);
+        exported.insert(exported.end(), sections.begin(), sections.end());
+        co_return {};
+    }
+
+    std::size_t count(PackageSectionDTO const& section) {
+        std::scoped_lock const lock(mutex);
+        return std::ranges::count(exported, section);
+    }
+
+    std::mutex mutex;
+    std::vector<PackageSectionDTO> exported;
+};
+
+PackageSectionDTO const stable {.branch = "stable", .repository = "core", .architecture = "x86_64"};
+PackageSectionDTO const testing {
+    .branch = "testing", .repository = "core", .architecture = "x86_64"};
+} // namespace
+
+TEST_CASE("WritebackScheduler", "[persistence][box]") {
+    auto scheduler = bxt::Utilities::SchedulerOptions {.thread_count = 2}.make_scheduler();
+    WritebackOptions options {.delay = 50, .sync_delay = 150, .max_staleness = 300};
+    RecordingExporter exporter;
+    WritebackScheduler writeback(scheduler, options, exporter);
+
+    SECTION("Changes within the delay are exported once") {
+        for (int i = 0; i < 5; ++i) {
+            writeback.schedule(stable);
+            std::this_thread::sleep_for(5ms);
+        }
+
+        REQUIRE(writeback.stats().pending.size() == 1);
+
+        std::this_thread::sleep_for(250ms);
+
+        REQUIRE(exporter.count(stable) == 1);
+        REQUIRE_FALSE(writeback.scheduled());
+        REQUIRE(writeback.stats().pending.empty());
+    }
+
+    SECTION("Sections are debounced independently") {
+        writeback.schedule(stable);
+        writeback.schedule(testing, WritebackPriority::Sync);
+
+        std::this_thread::sleep_for(100ms);
+
+        REQUIRE(exporter.count(stable) == 1);
+        REQUIRE(exporter.count(testing) == 0);
+
+        std::this_thread::sleep_for(250ms);
+
+        REQUIRE(exporter.count(testing) == 1);
+    }
+
+    SECTION("Steady changes are published within the maximum staleness") {
+        auto const started_at = std::chrono::steady_clock::now();
+
+        while (std::chrono::steady_clock::now() - started_at < 500ms) {
+            writeback.schedule(stable);
+            std::this_thread::sleep_for(20ms);
+        }
+
+        REQUIRE(exporter.count(stable) >= 1);
+    }
+
+    while (writeback.scheduled()) {
+        std::this_thread::sleep_for(10ms);
+    }
+}
@@ -0,0 +1,81 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/Database.h"
+#include "utilities/libarchive/Reader.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace bxt::Utilities::AlpmDb;
+
+TEST_CASE("Database fragments", "[utilities][alpmdb]") {
+    auto const archive_path =
+        std::filesystem::temp_directory_path() / "bxt-database-fragments-test.db.tar.zst";
+
+    std::map<std::string, std::string> const entries {
+        {"first-1-1/desc", "%NAME%\nfirst\n"},
+        {"second-1-1/desc", "%NAME%\nsecond\n"},
+        {"third-1-1/files", std::string(1000, 'x')}};
+
+    std::vector<std::string> fragments;
+    for (auto const& [name, contents] : entries) {
+        auto fragment = DatabaseUtils::make_archive_fragment(name, contents);
+
+        REQUIRE(fragment.has_value());
+        REQUIRE(fragment->size() % 512 == 0);
+
+        fragments.emplace_back(std::move(*fragment));
+    }
+
+    REQUIRE(DatabaseUtils::write_fragments_to_archive(archive_path, {fragments.begin(),
+                                                                     fragments.end()})
+                .has_value());
+
+    Archive::Reader reader;
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+    REQUIRE(reader.open_filename(archive_path).has_value());
+
+    std::map<std::string, std::string> read_entries;
+    for (auto& [header, entry] : reader) {
+        if (!header) {
+            continue;
+        }
+        auto contents = entry.read_all();
+        REQUIRE(contents.has_value());
+
+        read_entries.emplace(archive_entry_pathname(*header),
+                             std::string(contents->begin(), contents->end()));
+    }
+
+    REQUIRE(read_entries == entries);
+
+    SECTION("Rewriting doesn't touch the archive open readers have") {
+        std::ifstream before_file(archive_path, std::ios::binary);
+        std::string const before {std::istreambuf_iterator<char>(before_file),
+                                  std::istreambuf_iterator<char>()};
+        before_file.clear();
+        before_file.seekg(0);
+
+        REQUIRE(DatabaseUtils::write_fragments_to_archive(archive_path, {fragments.front()})
+                    .has_value());
+
+        std::string const opened {std::istreambuf_iterator<char>(before_file),
+                                  std::istreambuf_iterator<char>()};
+        REQUIRE(opened == before);
+
+        REQUIRE_FALSE(std::filesystem::exists(
+            archive_path.parent_path() / ("." + archive_path.filename().string() + ".tmp")));
+    }
+
+    std::filesystem::remove(archive_path);
+}
@@ -0,0 +1,99 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/alpmdb/DescFormatter.h"
+#include "utilities/alpmdb/PkgInfo.h"
+#include "utilities/hash_from_file.h"
+#include "utilities/libarchive/Reader.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+using namespace bxt::Utilities::AlpmDb;
+
+namespace {
+// Builds the desc the way it was done before the single pass: libarchive
+// reads the package for .PKGINFO, then DescFormatter reads it twice more to
+// hash it. Kept to compare the single pass against.
+std::string multi_pass_desc(std::filesystem::path const& path) {
+    Archive::Reader reader;
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_all(reader);
+    reader.open_filename(path);
+
+    PkgInfo package_info;
+    for (auto& [header, entry] : reader) {
+        if (header && std::string(archive_entry_pathname(*header)).ends_with(".PKGINFO")) {
+            auto contents = entry.read_all();
+            package_info.parse(
+                std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+            break;
+        }
+    }
+
+    return DescFormatter {package_info, path, ""}.format();
+}
+
+std::filesystem::path benchmark_package() {
+    if (auto const* path = std::getenv("BXT_BENCHMARK_PACKAGE")) {
+        return path;
+    }
+    return "data/dummy-1-1-any.pkg.tar.zst";
+}
+} // namespace
+
+TEST_CASE("Desc", "[utilities][alpmdb]") {
+    std::filesystem::path const file_path = "data/dummy-1-1-any.pkg.tar.zst";
+
+    SECTION("Single pass checksums match the file") {
+        auto desc = Desc::parse_package(file_path, "", false);
+
+        REQUIRE(desc.has_value());
+        REQUIRE(desc->get("CSIZE") == std::to_string(std::filesystem::file_size(file_path)));
+        REQUIRE(desc->get("MD5SUM") == bxt::hash_from_file<MD5, MD5_DIGEST_LENGTH>(file_path));
+        REQUIRE(desc->get("SHA256SUM")
+                == bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(file_path));
+    }
+
+    SECTION("Single pass matches the multi pass description") {
+        auto desc = Desc::parse_package(file_path, "", false);
+
+        REQUIRE(desc.has_value());
+        REQUIRE(desc->desc == multi_pass_desc(file_path));
+    }
+
+    SECTION("Files list is not built by default") {
+        auto desc = Desc::parse_package(file_path);
+
+        REQUIRE(desc.has_value());
+        REQUIRE(desc->files.empty());
+    }
+
+    SECTION("Files list skips package metadata") {
+        auto files = Desc::list_files(file_path);
+
+        REQUIRE(files.has_value());
+        REQUIRE_FALSE(files->empty());
+        REQUIRE_FALSE(files->starts_with("."));
+        REQUIRE(files->find("\n.") == std::string::npos);
+    }
+}
+
+TEST_CASE("Desc package ingest", "[.][benchmark][utilities][alpmdb]") {
+    auto const file_path = benchmark_package();
+
+    BENCHMARK("single pass") {
+        return Desc::parse_package(file_path, "", false);
+    };
+
+    BENCHMARK("multi pass") {
+        return multi_pass_desc(file_path);
+    };
+}
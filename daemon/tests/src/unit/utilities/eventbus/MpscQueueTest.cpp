@@ -0,0 +1,71 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/eventbus/MpscQueue.h"
+
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace bxt::Utilities;
+
+TEST_CASE("MpscQueue", "[utilities][eventbus]") {
+    SECTION("Empty queue") {
+        MpscQueue<int> queue;
+
+        REQUIRE_FALSE(queue.pop().has_value());
+    }
+
+    SECTION("Single producer keeps FIFO order") {
+        MpscQueue<int> queue;
+
+        for (int i = 0; i < 10; ++i) {
+            queue.push(i);
+        }
+
+        for (int i = 0; i < 10; ++i) {
+            auto value = queue.pop();
+            REQUIRE(value.has_value());
+            REQUIRE(*value == i);
+        }
+
+        REQUIRE_FALSE(queue.pop().has_value());
+    }
+
+    SECTION("Multiple producers keep per-producer order") {
+        constexpr int producer_count = 4;
+        constexpr int items_per_producer = 10000;
+
+        MpscQueue<std::pair<int, int>> queue;
+
+        std::vector<std::jthread> producers;
+        for (int producer = 0; producer < producer_count; ++producer) {
+            producers.emplace_back([&queue, producer] {
+                for (int i = 0; i < items_per_producer; ++i) {
+                    queue.push({producer, i});
+                }
+            });
+        }
+
+        std::array<int, producer_count> next_expected {};
+        int received = 0;
+
+        while (received < producer_count * items_per_producer) {
+            auto value = queue.pop();
+            if (!value) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto const [producer, index] = *value;
+            REQUIRE(index == next_expected[producer]);
+            next_expected[producer]++;
+            received++;
+        }
+    }
+}
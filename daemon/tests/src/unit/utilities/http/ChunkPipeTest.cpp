@@ -0,0 +1,57 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/http/ChunkPipe.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace bxt::Utilities::Http;
+
+TEST_CASE("ChunkPipe", "[http]") {
+    SECTION("Passes the data through in order") {
+        ChunkPipe pipe(16);
+
+        std::string expected;
+        for (int i = 0; i < 1000; ++i) {
+            expected += std::to_string(i);
+        }
+
+        bool written = true;
+        std::thread writer([&]() {
+            for (std::size_t offset = 0; offset < expected.size(); offset += 7) {
+                auto const chunk = std::string_view(expected).substr(offset, 7);
+                written = written && pipe.write(chunk.data(), chunk.size());
+            }
+            pipe.close_write();
+        });
+
+        std::string received;
+        for (auto chunk = pipe.read(); !chunk.empty(); chunk = pipe.read()) {
+            received += chunk;
+        }
+
+        writer.join();
+
+        REQUIRE(written);
+        REQUIRE(received == expected);
+    }
+
+    SECTION("Closing the reader unblocks the writer") {
+        ChunkPipe pipe(4);
+
+        REQUIRE(pipe.write("data", 4));
+
+        std::thread reader([&]() { pipe.close_read(); });
+
+        // Blocks until the reader is closed
+        REQUIRE_FALSE(pipe.write("more", 4));
+
+        reader.join();
+    }
+}
@@ -0,0 +1,150 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/http/ClientPool.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+using namespace bxt::Utilities::Http;
+using namespace std::chrono_literals;
+
+namespace {
+class LocalServer {
+public:
+    LocalServer() {
+        m_server.Get("/file", [](httplib::Request const&, httplib::Response& response) {
+            response.set_content("content", "text/plain");
+        });
+
+        m_port = m_server.bind_to_any_port("127.0.0.1");
+        m_thread = std::thread([this]() { m_server.listen_after_bind(); });
+        m_server.wait_until_ready();
+    }
+
+    ~LocalServer() {
+        m_server.stop();
+        m_thread.join();
+    }
+
+    int port() const {
+        return m_port;
+    }
+
+private:
+    httplib::Server m_server;
+    int m_port = 0;
+    std::thread m_thread;
+};
+
+ClientPool<httplib::Client>::Factory make_factory(int port) {
+    return [port](std::string const& host) {
+        auto client = std::make_unique<httplib::Client>(host, port);
+        client->set_keep_alive(true);
+        return client;
+    };
+}
+} // namespace
+
+TEST_CASE("ClientPool reuses keep-alive connections", "[http]") {
+    LocalServer server;
+    ClientPool<httplib::Client> pool(make_factory(server.port()), 4, 30s);
+
+    constexpr int requests = 10;
+
+    for (int i = 0; i < requests; ++i) {
+        auto client = pool.acquire("127.0.0.1");
+        auto const response = client->Get("/file");
+
+        REQUIRE(response);
+        REQUIRE(response->status == 200);
+        REQUIRE(response->body == "content");
+    }
+
+    auto const stats = pool.stats();
+    REQUIRE(stats.handshakes == 1);
+    REQUIRE(stats.reused == requests - 1);
+}
+
+TEST_CASE("ClientPool drops idle clients after the timeout", "[http]") {
+    LocalServer server;
+    ClientPool<httplib::Client> pool(make_factory(server.port()), 4, 0ms);
+
+    for (int i = 0; i < 3; ++i) {
+        auto client = pool.acquire("127.0.0.1");
+        REQUIRE(client->Get("/file"));
+    }
+
+    auto const stats = pool.stats();
+    REQUIRE(stats.handshakes == 3);
+    REQUIRE(stats.reused == 0);
+    REQUIRE(stats.expired == 2);
+}
+
+TEST_CASE("ClientPool keeps at most pool size idle clients per host", "[http]") {
+    LocalServer server;
+    ClientPool<httplib::Client> pool(make_factory(server.port()), 1, 30s);
+
+    {
+        auto first = pool.acquire("127.0.0.1");
+        auto second = pool.acquire("127.0.0.1");
+        REQUIRE(first->Get("/file"));
+        REQUIRE(second->Get("/file"));
+    }
+
+    {
+        auto first = pool.acquire("127.0.0.1");
+        auto second = pool.acquire("127.0.0.1");
+        REQUIRE(first->Get("/file"));
+        REQUIRE(second->Get("/file"));
+    }
+
+    auto const stats = pool.stats();
+    REQUIRE(stats.handshakes == 3);
+    REQUIRE(stats.reused == 1);
+}
+
+TEST_CASE("ClientPool doesn't return discarded clients", "[http]") {
+    LocalServer server;
+    ClientPool<httplib::Client> pool(make_factory(server.port()), 4, 30s);
+
+    {
+        auto client = pool.acquire("127.0.0.1");
+        REQUIRE(client->Get("/file"));
+        client.discard();
+    }
+
+    auto client = pool.acquire("127.0.0.1");
+    REQUIRE(client->Get("/file"));
+
+    REQUIRE(pool.stats().handshakes == 2);
+}
+
+TEST_CASE("ClientPool gets the client of a reassigned lease back", "[http]") {
+    LocalServer server;
+    ClientPool<httplib::Client> pool(make_factory(server.port()), 4, 30s);
+
+    auto client = pool.acquire("127.0.0.1");
+    REQUIRE(client->Get("/file"));
+
+    // The first connection goes back to the pool before the lease is
+    // replaced, so the third one reuses it
+    client = pool.acquire("127.0.0.1");
+    REQUIRE(client->Get("/file"));
+
+    auto third = pool.acquire("127.0.0.1");
+    REQUIRE(third->Get("/file"));
+
+    auto const stats = pool.stats();
+    REQUIRE(stats.handshakes == 2);
+    REQUIRE(stats.reused == 1);
+}
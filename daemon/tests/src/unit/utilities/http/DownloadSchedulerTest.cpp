@@ -0,0 +1,117 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/http/DownloadScheduler.h"
+#include "utilities/scheduler/SchedulerOptions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <coro/when_all.hpp>
+#include <fmt/format.h>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace bxt::Utilities::Http;
+using namespace std::chrono_literals;
+
+namespace {
+struct Concurrency {
+    void enter(std::string const& host) {
+        std::scoped_lock const lock(mutex);
+        peak = std::max(peak, ++total);
+        auto& count = per_host[host];
+        peak_per_host = std::max(peak_per_host, ++count);
+    }
+
+    void leave(std::string const& host) {
+        std::scoped_lock const lock(mutex);
+        --total;
+        --per_host[host];
+    }
+
+    std::mutex mutex;
+    int total = 0;
+    int peak = 0;
+    std::map<std::string, int> per_host;
+    int peak_per_host = 0;
+};
+} // namespace
+
+TEST_CASE("DownloadScheduler", "[http]") {
+    auto scheduler = bxt::Utilities::SchedulerOptions {.thread_count = 8}.make_scheduler();
+
+    SECTION("Limits the downloads in total and per host") {
+        DownloadScheduler downloads(scheduler, 4, 2);
+        Concurrency concurrency;
+
+        auto download = [&](std::string queue, std::string host) -> coro::task<void> {
+            auto permit = co_await downloads.acquire(queue, host);
+            concurrency.enter(host);
+            co_await scheduler->yield_for(5ms);
+            concurrency.leave(host);
+            permit.record(1024);
+        };
+
+        std::vector<coro::task<void>> tasks;
+        for (int i = 0; i < 30; ++i) {
+            tasks.emplace_back(download(i % 2 ? "stable" : "testing",
+                                        fmt::format("mirror{}", i % 3)));
+        }
+        coro::sync_wait(coro::when_all(std::move(tasks)));
+
+        REQUIRE(concurrency.peak <= 4);
+        REQUIRE(concurrency.peak_per_host <= 2);
+
+        auto const stats = downloads.stats();
+        REQUIRE(stats.downloads == 30);
+        REQUIRE(stats.bytes == 30 * 1024);
+        REQUIRE(stats.peak_in_flight <= 4);
+        REQUIRE(stats.in_flight == 0);
+        REQUIRE(stats.waiting == 0);
+    }
+
+    SECTION("Queues take turns for the free slots") {
+        DownloadScheduler downloads(scheduler, 1, 1);
+
+        // Holds the only slot until every download is queued
+        std::optional<DownloadScheduler::Permit> blocker =
+            coro::sync_wait(downloads.acquire("blocker", "mirror"));
+
+        std::mutex mutex;
+        std::vector<std::string> order;
+
+        auto download = [&](std::string queue) -> coro::task<void> {
+            auto permit = co_await downloads.acquire(queue, "mirror");
+            std::scoped_lock const lock(mutex);
+            order.emplace_back(queue);
+        };
+
+        std::vector<coro::task<void>> tasks;
+        for (int i = 0; i < 3; ++i) {
+            tasks.emplace_back(download("stable"));
+        }
+        for (int i = 0; i < 3; ++i) {
+            tasks.emplace_back(download("testing"));
+        }
+        auto release = [&]() -> coro::task<void> {
+            co_await scheduler->schedule();
+            blocker.reset();
+        };
+        tasks.emplace_back(release());
+
+        coro::sync_wait(coro::when_all(std::move(tasks)));
+
+        REQUIRE(order
+                == std::vector<std::string> {"stable", "testing", "stable", "testing", "stable",
+                                             "testing"});
+    }
+}
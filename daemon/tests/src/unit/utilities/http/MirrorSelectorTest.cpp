@@ -0,0 +1,194 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/http/MirrorSelector.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <fmt/format.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+using namespace bxt::Utilities::Http;
+using namespace std::chrono_literals;
+
+namespace {
+// A mirror stand-in that answers after a delay, or always fails
+class LocalMirror {
+public:
+    explicit LocalMirror(std::chrono::milliseconds delay, int status = 200) {
+        m_server.Get("/file", [delay, status](httplib::Request const&,
+                                              httplib::Response& response) {
+            std::this_thread::sleep_for(delay);
+            response.status = status;
+            response.set_content("content", "text/plain");
+        });
+
+        auto const port = m_server.bind_to_any_port("127.0.0.1");
+        m_url = fmt::format("http://127.0.0.1:{}", port);
+        m_thread = std::thread([this]() { m_server.listen_after_bind(); });
+        m_server.wait_until_ready();
+    }
+
+    ~LocalMirror() {
+        m_server.stop();
+        m_thread.join();
+    }
+
+    std::string const& url() const {
+        return m_url;
+    }
+
+private:
+    httplib::Server m_server;
+    std::string m_url;
+    std::thread m_thread;
+};
+
+void probe(MirrorSelector& selector, std::string const& mirror) {
+    httplib::Client client(mirror);
+
+    auto const started = MirrorSelector::Clock::now();
+    auto const response = client.Head("/file");
+
+    selector.record_probe(mirror, response ? std::optional(MirrorSelector::Clock::now() - started)
+                                           : std::nullopt);
+}
+
+// Downloads from the selected mirror, failing over to another one
+bool download(MirrorSelector& selector,
+              std::vector<std::string> const& mirrors,
+              std::vector<std::string>& used) {
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        auto const mirror = selector.select(mirrors);
+        used.push_back(mirror);
+
+        httplib::Client client(mirror);
+        auto const response = client.Get("/file");
+
+        if (response && response->status == 200) {
+            selector.record_success(mirror, 1024.0 * 1024.0);
+            return true;
+        }
+        selector.record_failure(mirror);
+    }
+    return false;
+}
+} // namespace
+
+TEST_CASE("MirrorSelector prefers the faster mirror", "[http]") {
+    LocalMirror fast(0ms);
+    LocalMirror slow(40ms);
+    std::vector<std::string> const mirrors {fast.url(), slow.url()};
+
+    MirrorSelector selector;
+
+    probe(selector, fast.url());
+    probe(selector, slow.url());
+
+    int fast_selected = 0;
+    for (int i = 0; i < 1000; ++i) {
+        fast_selected += selector.select(mirrors) == fast.url();
+    }
+
+    REQUIRE(fast_selected > 700);
+    // The slower mirror still gets some of the downloads
+    REQUIRE(fast_selected < 1000);
+}
+
+TEST_CASE("MirrorSelector fails over and opens the breaker of a broken mirror", "[http]") {
+    LocalMirror healthy(0ms);
+    LocalMirror broken(0ms, 500);
+    std::vector<std::string> const mirrors {healthy.url(), broken.url()};
+
+    MirrorSelector selector({.failure_threshold = 3, .cooldown = 60s});
+
+    std::vector<std::string> used;
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(download(selector, mirrors, used));
+    }
+
+    auto const broken_requests = std::ranges::count(used, broken.url());
+    REQUIRE(broken_requests <= 3);
+
+    auto const stats = selector.stats(mirrors);
+    REQUIRE(stats[0].available);
+    REQUIRE(stats[1].available == (broken_requests < 3));
+}
+
+TEST_CASE("MirrorSelector retries a mirror after the cooldown", "[http]") {
+    std::vector<std::string> const mirrors {"http://a", "http://b"};
+
+    MirrorSelector selector({.failure_threshold = 2, .cooldown = 50ms});
+
+    selector.record_failure("http://a");
+    selector.record_failure("http://a");
+
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(selector.select(mirrors) == "http://b");
+    }
+
+    std::this_thread::sleep_for(60ms);
+    REQUIRE(selector.stats(mirrors)[0].available);
+
+    // A failed retry opens the breaker again right away
+    selector.record_failure("http://a");
+    REQUIRE_FALSE(selector.stats(mirrors)[0].available);
+
+    std::this_thread::sleep_for(60ms);
+    selector.record_success("http://a", 1024);
+    REQUIRE(selector.stats(mirrors)[0].consecutive_failures == 0);
+}
+
+TEST_CASE("MirrorSelector returns the closest mirror when all breakers are open", "[http]") {
+    std::vector<std::string> const mirrors {"http://a", "http://b"};
+
+    MirrorSelector selector({.failure_threshold = 1, .cooldown = 60s});
+
+    selector.record_failure("http://a");
+    std::this_thread::sleep_for(5ms);
+    selector.record_failure("http://b");
+
+    REQUIRE(selector.select(mirrors) == "http://a");
+}
+
+TEST_CASE("MirrorSelector sends a single trial to a half-open mirror", "[http]") {
+    std::vector<std::string> const mirrors {"http://a", "http://b"};
+
+    MirrorSelector selector({.failure_threshold = 2, .cooldown = 50ms});
+
+    selector.record_failure("http://a");
+    selector.record_failure("http://a");
+    std::this_thread::sleep_for(60ms);
+
+    int trials = 0;
+    for (int i = 0; i < 1000; ++i) {
+        trials += selector.select(mirrors) == "http://a";
+    }
+
+    REQUIRE(trials == 1);
+    REQUIRE_FALSE(selector.stats(mirrors)[0].available);
+
+    // The trial succeeded, the mirror is back
+    selector.record_success("http://a", 1024);
+    REQUIRE(selector.stats(mirrors)[0].available);
+}
+
+TEST_CASE("MirrorSelector probes a mirror once per cooldown", "[http]") {
+    MirrorSelector selector({.failure_threshold = 2, .cooldown = 50ms});
+
+    REQUIRE(selector.claim_probe("http://a"));
+    REQUIRE_FALSE(selector.claim_probe("http://a"));
+    REQUIRE(selector.claim_probe("http://b"));
+
+    std::this_thread::sleep_for(60ms);
+    REQUIRE(selector.claim_probe("http://a"));
+}
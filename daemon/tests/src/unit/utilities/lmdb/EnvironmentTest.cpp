@@ -0,0 +1,125 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/lmdb/Environment.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <thread>
+#include <utility>
+
+using namespace bxt::Utilities::LMDB;
+using namespace std::chrono_literals;
+
+namespace {
+std::shared_ptr<Environment> make_environment(bool concurrent_reads) {
+    auto const path = std::filesystem::temp_directory_path()
+                      / (concurrent_reads ? "bxt-lmdb-concurrent" : "bxt-lmdb-locked");
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+
+    auto environment = std::make_shared<Environment>(coro::io_scheduler::make_shared());
+    environment->set_concurrent_reads(concurrent_reads);
+    environment->env().set_max_dbs(4);
+    environment->env().open(path.c_str(), environment->open_flags(), 0664);
+
+    return environment;
+}
+
+// The threads a write transaction ran on and its caller was resumed on
+coro::task<std::pair<std::thread::id, std::thread::id>>
+    write_threads(Environment& environment) {
+    auto txn = co_await environment.begin_rw_txn();
+    auto const writer_thread = std::this_thread::get_id();
+
+    co_await environment.commit_rw_txn(*txn);
+
+    co_return std::pair {writer_thread, std::this_thread::get_id()};
+}
+} // namespace
+
+TEST_CASE("LMDB Environment", "[utilities][lmdb]") {
+    SECTION("Reads proceed while a write transaction is open") {
+        auto environment = make_environment(true);
+
+        auto setup_txn = coro::sync_wait(environment->begin_rw_txn());
+        auto dbi = lmdb::dbi::open(setup_txn->value, "test", MDB_CREATE);
+        dbi.put(setup_txn->value, "key", "committed");
+        coro::sync_wait(environment->commit_rw_txn(*setup_txn));
+        setup_txn.reset();
+
+        auto writer = coro::sync_wait(environment->begin_rw_txn());
+        dbi.put(writer->value, "key", "uncommitted");
+
+        auto reader = std::async(std::launch::async, [&environment] {
+            return coro::sync_wait(environment->begin_ro_txn());
+        });
+
+        REQUIRE(reader.wait_for(1s) == std::future_status::ready);
+
+        auto reader_txn = reader.get();
+        std::string_view value;
+        REQUIRE(dbi.get(reader_txn->value, "key", value));
+        REQUIRE(value == "committed");
+
+        coro::sync_wait(environment->commit_rw_txn(*writer));
+    }
+
+    SECTION("Write transactions can be finished on another thread") {
+        auto environment = make_environment(true);
+
+        auto writer = coro::sync_wait(environment->begin_rw_txn());
+        auto dbi = lmdb::dbi::open(writer->value, "test", MDB_CREATE);
+        dbi.put(writer->value, "key", "committed");
+
+        std::async(std::launch::async, [&environment, &writer] {
+            coro::sync_wait(environment->commit_rw_txn(*writer));
+        }).get();
+
+        auto next_writer = std::async(std::launch::async, [&environment] {
+            return coro::sync_wait(environment->begin_rw_txn());
+        });
+
+        REQUIRE(next_writer.wait_for(1s) == std::future_status::ready);
+
+        auto next_txn = next_writer.get();
+        std::string_view value;
+        REQUIRE(dbi.get(next_txn->value, "key", value));
+        REQUIRE(value == "committed");
+
+        coro::sync_wait(environment->abort_rw_txn(*next_txn));
+    }
+
+    SECTION("The caller leaves the writer thread once the transaction is finished") {
+        auto environment = make_environment(true);
+
+        auto const [writer_thread, caller_thread] = coro::sync_wait(write_threads(*environment));
+
+        REQUIRE(writer_thread != caller_thread);
+    }
+
+    SECTION("Reads wait for the writer when concurrent reads are disabled") {
+        auto environment = make_environment(false);
+
+        auto writer = coro::sync_wait(environment->begin_rw_txn());
+
+        auto reader = std::async(std::launch::async, [&environment] {
+            return coro::sync_wait(environment->begin_ro_txn());
+        });
+
+        REQUIRE(reader.wait_for(100ms) == std::future_status::timeout);
+
+        coro::sync_wait(environment->abort_rw_txn(*writer));
+        writer.reset();
+
+        REQUIRE(reader.wait_for(1s) == std::future_status::ready);
+        REQUIRE(reader.get() != nullptr);
+    }
+}
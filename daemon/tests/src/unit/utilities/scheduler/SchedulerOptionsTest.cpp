@@ -0,0 +1,62 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/scheduler/SchedulerOptions.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <coro/task.hpp>
+
+using namespace bxt::Utilities;
+using namespace std::chrono_literals;
+
+namespace {
+coro::task<std::chrono::steady_clock::duration>
+    measure_schedule_after(std::shared_ptr<coro::io_scheduler> scheduler,
+                           std::chrono::milliseconds delay) {
+    auto const started_at = std::chrono::steady_clock::now();
+    co_await scheduler->schedule_after(delay);
+    co_return std::chrono::steady_clock::now() - started_at;
+}
+
+coro::task<void> schedule_once(std::shared_ptr<coro::io_scheduler> scheduler) {
+    co_await scheduler->schedule();
+}
+} // namespace
+
+TEST_CASE("SchedulerOptions", "[utilities][scheduler]") {
+    SECTION("Deserialize thread count") {
+        Configuration configuration(toml::table {{"scheduler-threads", 2}});
+        SchedulerOptions options;
+
+        options.deserialize(configuration);
+
+        REQUIRE(options.thread_count == 2);
+    }
+
+    SECTION("Timers fire without an external event pump") {
+        auto scheduler = SchedulerOptions {}.make_scheduler();
+
+        auto const elapsed = coro::sync_wait(measure_schedule_after(scheduler, 50ms));
+
+        REQUIRE(elapsed >= 50ms);
+        REQUIRE(elapsed < 500ms);
+    }
+}
+
+TEST_CASE("io_scheduler latency", "[.][benchmark][utilities][scheduler]") {
+    auto scheduler = SchedulerOptions {}.make_scheduler();
+
+    BENCHMARK("schedule") {
+        return coro::sync_wait(schedule_once(scheduler));
+    };
+
+    BENCHMARK("schedule_after 10ms") {
+        return coro::sync_wait(measure_schedule_after(scheduler, 10ms));
+    };
+}
@@ -0,0 +1,53 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iomanip>
+#include <memory>
+#include <openssl/evp.h>
+#include <sstream>
+#include <string>
+
+namespace bxt {
+
+// Incremental digest over data that arrives in chunks, e.g. while a file is
+// being read or downloaded. The digest is formatted the same way as
+// hash_from_file does it.
+class StreamingHasher {
+public:
+    explicit StreamingHasher(EVP_MD const* algorithm)
+        : m_context(EVP_MD_CTX_new(), &EVP_MD_CTX_free) {
+        EVP_DigestInit_ex(m_context.get(), algorithm, nullptr);
+    }
+
+    void update(void const* data, std::size_t size) {
+        EVP_DigestUpdate(m_context.get(), data, size);
+    }
+
+    // Finalizes the digest, the hasher can't be updated after that
+    std::string hex_digest() {
+        std::array<unsigned char, EVP_MAX_MD_SIZE> result;
+        unsigned int length = 0;
+
+        EVP_DigestFinal_ex(m_context.get(), result.data(), &length);
+
+        std::ostringstream sout;
+        sout << std::hex << std::setfill('0');
+        for (unsigned int i = 0; i < length; ++i) {
+            sout << std::setw(2) << static_cast<int>(result[i]);
+        }
+
+        return sout.str();
+    }
+
+private:
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> m_context;
+};
+
+} // namespace bxt
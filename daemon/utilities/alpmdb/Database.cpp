@@ -14,6 +14,7 @@
 #include "utilities/log/Logging.h"
 
 #include <algorithm>
+#include <array>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -23,6 +24,8 @@
 #include <filesystem>
 #include <fmt/format.h>
 #include <iterator>
+#include <nonstd/scope.hpp>
+#include <system_error>
 #include <utilities/libarchive/Reader.h>
 #include <utilities/libarchive/Writer.h>
 
@@ -150,7 +153,7 @@ coro::task<Result<void>>
     accept(std::set<std::string> files,
            std::function<void(std::string const& name, Desc const& description)> visitor) {
     for (auto const& package : files) {
-        auto description = Desc::parse_package(package);
+        auto description = Desc::parse_package(package, "", true);
         if (!description.has_value()) {
             co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidEntityError);
         }
@@ -166,4 +169,121 @@ coro::task<Result<void>>
     }
 }
 
+Result<std::string> make_archive_fragment(std::string const& name, std::string const& buffer) {
+    constexpr std::size_t tar_block_size = 512;
+    constexpr std::size_t end_of_archive_size = 2 * tar_block_size;
+
+    Archive::Writer writer;
+
+    // No compression and no padding to the default 10KiB blocks, so the
+    // output is exactly the entry followed by the end-of-archive marker
+    archive_write_set_format_pax_restricted(writer);
+    archive_write_set_bytes_per_block(writer, tar_block_size);
+    archive_write_set_bytes_in_last_block(writer, tar_block_size);
+
+    // Room for the data, the ustar header and a pax extended header in case
+    // the name doesn't fit into ustar
+    std::vector<std::byte> output(buffer.size() + 2 * name.size() + 8 * tar_block_size
+                                  + end_of_archive_size);
+    std::size_t used = 0;
+
+    if (auto open_ok = writer.open_memory(output, used); !open_ok.has_value()) {
+        return bxt::make_error_with_source<DatabaseError>(std::move(open_ok.error()),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    if (auto write_ok = write_buffer_to_archive(writer, name, buffer); !write_ok.has_value()) {
+        return std::unexpected(std::move(write_ok.error()));
+    }
+
+    if (archive_write_close(writer) != ARCHIVE_OK) {
+        return bxt::make_error_with_source<DatabaseError>(Archive::LibArchiveError(writer),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    if (used < end_of_archive_size) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::IOError);
+    }
+
+    return std::string(reinterpret_cast<char const*>(output.data()), used - end_of_archive_size);
+}
+
+Result<void> write_fragments_to_archive(std::filesystem::path const& path,
+                                        std::vector<std::string_view> const& fragments) {
+    // Two zero filled tar blocks
+    static constexpr std::array<char, 1024> end_of_archive {};
+
+    Archive::Writer writer;
+
+    // The fragments already are a tar stream, so it's written as a single
+    // raw entry and only goes through the compression filter
+    archive_write_add_filter_zstd(writer);
+    archive_write_set_format_raw(writer);
+
+    // A client may still be reading the archive this one replaces, so it's
+    // written aside and renamed over it
+    auto const temporary_path =
+        path.parent_path() / fmt::format(".{}.tmp", path.filename().string());
+
+    auto cleanup = nonstd::make_scope_exit([&temporary_path]() {
+        std::error_code ec;
+        std::filesystem::remove(temporary_path, ec);
+    });
+
+    if (auto open_ok = writer.open_filename(temporary_path); !open_ok.has_value()) {
+        return bxt::make_error_with_source<DatabaseError>(std::move(open_ok.error()),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    std::size_t size = end_of_archive.size();
+    for (auto const& fragment : fragments) {
+        size += fragment.size();
+    }
+
+    auto header = Archive::Header::default_file();
+    archive_entry_set_pathname(header, path.filename().c_str());
+    archive_entry_set_size(header, static_cast<la_int64_t>(size));
+
+    auto entry = writer.start_write(header);
+    if (!entry.has_value()) {
+        return bxt::make_error_with_source<DatabaseError>(std::move(entry.error()),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    auto const write_data = [&writer](std::string_view data) {
+        return archive_write_data(writer, data.data(), data.size())
+               == static_cast<la_ssize_t>(data.size());
+    };
+
+    for (auto const& fragment : fragments) {
+        if (!write_data(fragment)) {
+            return bxt::make_error_with_source<DatabaseError>(Archive::LibArchiveError(writer),
+                                                              DatabaseError::ErrorType::IOError);
+        }
+    }
+
+    if (!write_data({end_of_archive.data(), end_of_archive.size()})) {
+        return bxt::make_error_with_source<DatabaseError>(Archive::LibArchiveError(writer),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    if (auto finish_ok = entry->finish(); !finish_ok.has_value()) {
+        return bxt::make_error_with_source<DatabaseError>(std::move(finish_ok.error()),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    if (archive_write_close(writer) != ARCHIVE_OK) {
+        return bxt::make_error_with_source<DatabaseError>(Archive::LibArchiveError(writer),
+                                                          DatabaseError::ErrorType::IOError);
+    }
+
+    std::error_code ec;
+    if (std::filesystem::rename(temporary_path, path, ec); ec) {
+        return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::IOError);
+    }
+    cleanup.release();
+
+    return {};
+}
+
 } // namespace bxt::Utilities::AlpmDb::DatabaseUtils
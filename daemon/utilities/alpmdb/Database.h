@@ -31,6 +31,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace bxt::Utilities::AlpmDb::DatabaseUtils {
 
@@ -82,4 +83,14 @@ Result<void> write_buffer_to_archive(Archive::Writer& writer,
 coro::task<Result<void>> save(phmap::parallel_flat_hash_map<std::string, Desc> descriptions,
                               std::filesystem::path path);
 
+// Builds a single uncompressed tar entry without the end-of-archive marker.
+// Fragments can be cached and later concatenated by
+// write_fragments_to_archive, so unchanged entries are not formatted again.
+Result<std::string> make_archive_fragment(std::string const& name, std::string const& buffer);
+
+// Writes the concatenated fragments as a zstd compressed tar archive. The
+// archive at path is replaced atomically.
+Result<void> write_fragments_to_archive(std::filesystem::path const& path,
+                                        std::vector<std::string_view> const& fragments);
+
 } // namespace bxt::Utilities::AlpmDb::DatabaseUtils
@@ -10,15 +10,19 @@
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/libarchive/Error.h"
 #include "utilities/libarchive/Reader.h"
+#include "utilities/StreamingHasher.h"
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
 #include <expected>
 #include <fmt/format.h>
 #include <frozen/set.h>
 #include <frozen/string.h>
 #include <frozen/unordered_map.h>
+#include <fstream>
 #include <optional>
+#include <vector>
 
 namespace bxt::Utilities::AlpmDb {
 std::optional<std::string> Desc::get(std::string const& key) const {
@@ -45,12 +49,45 @@ Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
     std::ostringstream desc;
     std::ostringstream files;
 
+    // The package file is read only once: every raw block is fed to the
+    // digests before libarchive decodes it, so the checksums and the
+    // compressed size come out of the same pass that finds .PKGINFO
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        return std::unexpected(ParseError(ParseError::ErrorType::InvalidArchive));
+    }
+
+    constexpr std::size_t block_size = 64 * 1024;
+    std::vector<char> block(block_size);
+
+    StreamingHasher md5(EVP_md5());
+    StreamingHasher sha256(EVP_sha256());
+    uint64_t csize = 0;
+
+    auto const read_block = [&]() -> la_ssize_t {
+        file.read(block.data(), static_cast<std::streamsize>(block.size()));
+        auto const read_size = file.gcount();
+
+        if (read_size <= 0) {
+            return file.bad() ? -1 : 0;
+        }
+
+        md5.update(block.data(), read_size);
+        sha256.update(block.data(), read_size);
+        csize += read_size;
+
+        return read_size;
+    };
+
     Archive::Reader file_reader;
 
     archive_read_support_filter_all(file_reader);
     archive_read_support_format_all(file_reader);
 
-    auto const package_infos = file_reader.open_filename(filepath);
+    auto const package_infos = file_reader.open_callback([&](void const** buffer) {
+        *buffer = block.data();
+        return read_block();
+    });
 
     if (!package_infos.has_value()) {
         return std::unexpected(
@@ -100,11 +137,53 @@ Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
         return std::unexpected(ParseError(ParseError::ErrorType::NoPackageInfo));
     }
 
-    DescFormatter formatter {package_info, filepath, signature};
+    // Whatever libarchive didn't need still has to go through the digests
+    while (read_block() > 0) {
+    }
+
+    if (file.bad()) {
+        return std::unexpected(ParseError(ParseError::ErrorType::InvalidArchive));
+    }
+
+    DescFormatter formatter {package_info, filepath, signature,
+                             PackageChecksums {.csize = csize,
+                                               .md5sum = md5.hex_digest(),
+                                               .sha256sum = sha256.hex_digest()}};
 
     desc << formatter.format();
 
     return Desc {.desc = desc.str(), .files = files.str()};
 }
 
+Desc::Result<std::string> Desc::list_files(std::filesystem::path const& filepath) {
+    Archive::Reader file_reader;
+
+    archive_read_support_filter_all(file_reader);
+    archive_read_support_format_all(file_reader);
+
+    if (auto opened = file_reader.open_filename(filepath); !opened.has_value()) {
+        return std::unexpected(
+            ParseError(ParseError::ErrorType::InvalidArchive, std::move(opened.error())));
+    }
+
+    std::ostringstream files;
+
+    for (auto& [header, entry] : file_reader) {
+        if (!header) {
+            continue;
+        }
+        std::string_view const pathname = archive_entry_pathname(*header);
+
+        // Package metadata (.PKGINFO, .BUILDINFO, .MTREE, ...) is not
+        // installed, so it doesn't belong to the files list
+        if (pathname.starts_with(".")) {
+            continue;
+        }
+
+        files << pathname << "\n";
+    }
+
+    return files.str();
+}
+
 } // namespace bxt::Utilities::AlpmDb
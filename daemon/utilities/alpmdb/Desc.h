@@ -54,9 +54,15 @@ struct Desc {
         ar(desc, files);
     }
 
+    // Only .PKGINFO is needed for the description, so by default the archive
+    // is not walked past it. Pass create_files to also fill the files list.
     static Result<Desc> parse_package(std::filesystem::path const& filepath,
                                       std::string const& signature = "",
-                                      bool create_files = true);
+                                      bool create_files = false);
+
+    // Lists the package contents in the files database format without
+    // computing the description
+    static Result<std::string> list_files(std::filesystem::path const& filepath);
 
     std::optional<std::string> get(std::string const& key) const;
 
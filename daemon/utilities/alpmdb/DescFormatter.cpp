@@ -25,14 +25,22 @@ std::string DescFormatter::format() const {
     oss << format_pkginfo_entry<"VERSION", "pkgver">();
     oss << format_pkginfo_entry<"DESC", "pkgdesc">();
     oss << format_pkginfo_entry<"GROUPS", "groups">();
-    oss << format_entry<"CSIZE">(std::to_string(std::filesystem::file_size(m_filepath)));
+
+    auto const checksums =
+        m_checksums ? *m_checksums
+                    : PackageChecksums {
+                          .csize = std::filesystem::file_size(m_filepath),
+                          .md5sum = bxt::hash_from_file<MD5, MD5_DIGEST_LENGTH>(m_filepath.string()),
+                          .sha256sum = bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(
+                              m_filepath.string())};
+
+    oss << format_entry<"CSIZE">(std::to_string(checksums.csize));
     oss << format_pkginfo_entry<"ISIZE", "size">();
 
     // add checksums
-    oss << format_entry<"MD5SUM">(bxt::hash_from_file<MD5, MD5_DIGEST_LENGTH>(m_filepath.string()));
+    oss << format_entry<"MD5SUM">(checksums.md5sum);
 
-    oss << format_entry<"SHA256SUM">(
-        bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(m_filepath.string()));
+    oss << format_entry<"SHA256SUM">(checksums.sha256sum);
 
     // add PGP sig
     if (!m_signature.empty()) {
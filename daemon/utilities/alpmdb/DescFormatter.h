@@ -10,19 +10,33 @@
 #include "utilities/FixedString.h"
 
 #include <boost/algorithm/string/join.hpp>
+#include <cstdint>
 #include <filesystem>
 #include <fmt/format.h>
 #include <openssl/md5.h>
 #include <openssl/sha.h>
+#include <optional>
 #include <string>
 
 namespace bxt::Utilities::AlpmDb {
+// Sizes and digests of the package file. When they are known upfront (e.g.
+// computed while the package was read) the file isn't read again.
+struct PackageChecksums {
+    uint64_t csize = 0;
+    std::string md5sum;
+    std::string sha256sum;
+};
+
 class DescFormatter {
 public:
-    DescFormatter(PkgInfo m_pkg_info, std::filesystem::path m_filepath, std::string m_signature)
+    DescFormatter(PkgInfo m_pkg_info,
+                  std::filesystem::path m_filepath,
+                  std::string m_signature,
+                  std::optional<PackageChecksums> m_checksums = std::nullopt)
         : m_pkg_info(std::move(m_pkg_info))
         , m_filepath(std::move(m_filepath))
-        , m_signature(std::move(m_signature)) {
+        , m_signature(std::move(m_signature))
+        , m_checksums(std::move(m_checksums)) {
     }
 
     static constexpr char format_string[] = "%{}%\n{}\n\n";
@@ -49,6 +63,7 @@ private:
     PkgInfo m_pkg_info;
     std::filesystem::path m_filepath;
     std::string m_signature;
+    std::optional<PackageChecksums> m_checksums;
 };
 
 } // namespace bxt::Utilities::AlpmDb
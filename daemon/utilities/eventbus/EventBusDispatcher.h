@@ -7,27 +7,55 @@
 #pragma once
 
 #include "events.h"
+#include "utilities/eventbus/MpscQueue.h"
 #include "utilities/log/Logging.h"
 
+#include <atomic>
+#include <chrono>
 #include <coro/task.hpp>
+#include <cstdint>
 #include <dexode/EventBus.hpp>
+#include <functional>
 #include <memory>
+#include <stop_token>
+#include <thread>
 #include <typeindex>
 
 namespace bxt::Utilities {
 
+// Events are pushed into a lock-free queue and delivered to the event bus
+// listeners by a dedicated consumer thread as soon as they arrive. A single
+// consumer keeps the delivery order equal to the dispatch order.
 class EventBusDispatcher {
 public:
+    struct Stats {
+        std::size_t queue_depth;
+        uint64_t dispatched;
+        std::chrono::microseconds last_latency;
+        std::chrono::microseconds max_latency;
+    };
+
     EventBusDispatcher(std::shared_ptr<dexode::EventBus> evbus)
-        : m_evbus(evbus) {
+        : m_evbus(evbus)
+        , m_consumer([this](std::stop_token stop) { consume(stop); }) {
+    }
+
+    ~EventBusDispatcher() {
+        m_consumer.request_stop();
+        m_depth.fetch_add(1, std::memory_order_release);
+        m_depth.notify_one();
     }
 
     template<typename TEvent> inline void process(TEvent eptr) {
         if (auto const it = bxt::events::event_map.find(std::type_index(typeid(*eptr)));
             it != bxt::events::event_map.cend()) {
-            auto tindex = std::type_index(typeid(*eptr));
-            auto str = tindex.name();
-            it->second(eptr.get(), m_evbus);
+            m_queue.push(
+                {.deliver = [visitor = it->second, eptr,
+                             evbus = m_evbus]() mutable { visitor(eptr.get(), evbus); },
+                 .enqueued_at = std::chrono::steady_clock::now()});
+
+            m_depth.fetch_add(1, std::memory_order_release);
+            m_depth.notify_one();
         }
     }
 
@@ -53,8 +81,69 @@ public:
         logt(event->message());
     }
 
+    Stats stats() const {
+        return {.queue_depth = m_depth.load(std::memory_order_acquire),
+                .dispatched = m_dispatched.load(std::memory_order_relaxed),
+                .last_latency =
+                    std::chrono::microseconds(m_last_latency_us.load(std::memory_order_relaxed)),
+                .max_latency =
+                    std::chrono::microseconds(m_max_latency_us.load(std::memory_order_relaxed))};
+    }
+
 private:
+    struct Delivery {
+        std::function<void()> deliver;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    void consume(std::stop_token stop) {
+        while (!stop.stop_requested()) {
+            m_depth.wait(0, std::memory_order_acquire);
+
+            while (m_depth.load(std::memory_order_acquire) > 0 && !stop.stop_requested()) {
+                auto delivery = m_queue.pop();
+
+                // A producer has reserved the slot but not linked the node
+                if (!delivery) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                delivery->deliver();
+                m_evbus->process();
+
+                m_depth.fetch_sub(1, std::memory_order_acq_rel);
+                record_latency(delivery->enqueued_at);
+            }
+        }
+    }
+
+    void record_latency(std::chrono::steady_clock::time_point enqueued_at) {
+        auto const latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - enqueued_at)
+                                 .count();
+
+        m_dispatched.fetch_add(1, std::memory_order_relaxed);
+        m_last_latency_us.store(latency, std::memory_order_relaxed);
+
+        auto max_latency = m_max_latency_us.load(std::memory_order_relaxed);
+        while (latency > max_latency
+               && !m_max_latency_us.compare_exchange_weak(max_latency, latency,
+                                                          std::memory_order_relaxed)) {
+        }
+    }
+
     std::shared_ptr<dexode::EventBus> m_evbus;
+
+    MpscQueue<Delivery> m_queue;
+    std::atomic<std::size_t> m_depth = 0;
+
+    std::atomic<uint64_t> m_dispatched = 0;
+    std::atomic<int64_t> m_last_latency_us = 0;
+    std::atomic<int64_t> m_max_latency_us = 0;
+
+    // Declared last so the consumer is joined before the queue is destroyed
+    std::jthread m_consumer;
 };
 
 } // namespace bxt::Utilities
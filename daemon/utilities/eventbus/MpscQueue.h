@@ -0,0 +1,72 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace bxt::Utilities {
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov). Any
+// thread can push, only one thread is allowed to pop. Items are popped in
+// the order their pushes were linked.
+template<typename T> class MpscQueue {
+public:
+    MpscQueue() {
+        auto* stub = new Node;
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    MpscQueue(MpscQueue const&) = delete;
+    MpscQueue& operator=(MpscQueue const&) = delete;
+
+    ~MpscQueue() {
+        while (pop()) {
+        }
+        delete m_tail;
+    }
+
+    void push(T value) {
+        auto* node = new Node;
+        node->value.emplace(std::move(value));
+
+        auto* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Returns nothing if the queue is empty or a producer has not finished
+    // linking its node yet
+    std::optional<T> pop() {
+        auto* tail = m_tail;
+        auto* next = tail->next.load(std::memory_order_acquire);
+
+        if (!next) {
+            return std::nullopt;
+        }
+
+        m_tail = next;
+        std::optional<T> result = std::move(next->value);
+        next->value.reset();
+
+        delete tail;
+
+        return result;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next = nullptr;
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+};
+
+} // namespace bxt::Utilities
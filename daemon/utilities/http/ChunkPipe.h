@@ -0,0 +1,92 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace bxt::Utilities::Http {
+
+// Hands a response body from the thread receiving it over to a thread
+// consuming it, e.g. a libarchive reader. At most about capacity bytes are
+// buffered: the writer blocks until the reader catches up.
+class ChunkPipe {
+public:
+    explicit ChunkPipe(std::size_t capacity)
+        : m_capacity(capacity) {
+    }
+
+    // Returns false once the reader is closed, the data is then dropped
+    bool write(char const* data, std::size_t size) {
+        std::unique_lock lock(m_mutex);
+        m_writable.wait(lock, [this]() { return m_buffered < m_capacity || m_read_closed; });
+
+        if (m_read_closed) {
+            return false;
+        }
+
+        m_chunks.emplace_back(data, size);
+        m_buffered += size;
+        m_readable.notify_one();
+
+        return true;
+    }
+
+    // Marks the end of the data
+    void close_write() {
+        std::scoped_lock const lock(m_mutex);
+        m_write_closed = true;
+        m_readable.notify_all();
+    }
+
+    // Blocks until the next chunk is available. The returned data stays valid
+    // until the next call, it's empty at the end of the data.
+    std::string_view read() {
+        std::unique_lock lock(m_mutex);
+        m_readable.wait(lock,
+                        [this]() { return !m_chunks.empty() || m_write_closed || m_read_closed; });
+
+        if (m_chunks.empty() || m_read_closed) {
+            return {};
+        }
+
+        m_current = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_buffered -= m_current.size();
+        m_writable.notify_one();
+
+        return m_current;
+    }
+
+    // The reader doesn't need more data, unblocks the writer
+    void close_read() {
+        std::scoped_lock const lock(m_mutex);
+        m_read_closed = true;
+        m_chunks.clear();
+        m_buffered = 0;
+        m_writable.notify_all();
+    }
+
+private:
+    std::size_t const m_capacity;
+
+    std::mutex m_mutex;
+    std::condition_variable m_readable;
+    std::condition_variable m_writable;
+
+    std::deque<std::string> m_chunks;
+    std::string m_current;
+    std::size_t m_buffered = 0;
+    bool m_write_closed = false;
+    bool m_read_closed = false;
+};
+
+} // namespace bxt::Utilities::Http
@@ -0,0 +1,168 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bxt::Utilities::Http {
+
+// Per-host pool of keep-alive HTTP clients. A client is leased for a request
+// and returned to the pool afterwards, so the next request to the same host
+// reuses its open connection instead of doing a new TCP and TLS handshake.
+// TClient is expected to be a httplib client with keep-alive enabled.
+template<typename TClient> class ClientPool {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Factory = std::function<std::unique_ptr<TClient>(std::string const& host)>;
+
+    struct Stats {
+        uint64_t reused = 0;
+        uint64_t handshakes = 0;
+        uint64_t expired = 0;
+    };
+
+    class Lease {
+    public:
+        Lease(ClientPool* pool, std::string host, std::unique_ptr<TClient> client)
+            : m_pool(pool)
+            , m_host(std::move(host))
+            , m_client(std::move(client)) {
+        }
+        Lease(Lease&&) noexcept = default;
+        // The client held so far is returned to the pool first
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                give_back();
+                m_pool = std::exchange(other.m_pool, nullptr);
+                m_host = std::move(other.m_host);
+                m_client = std::move(other.m_client);
+            }
+            return *this;
+        }
+        Lease(Lease const&) = delete;
+        Lease& operator=(Lease const&) = delete;
+
+        ~Lease() {
+            give_back();
+        }
+
+        TClient* operator->() const {
+            return m_client.get();
+        }
+        TClient& operator*() const {
+            return *m_client;
+        }
+        explicit operator bool() const {
+            return m_client != nullptr;
+        }
+
+        // Drops the client instead of returning it to the pool, used when
+        // the connection may be in a broken state
+        void discard() {
+            m_client.reset();
+        }
+
+    private:
+        void give_back() {
+            if (m_pool && m_client) {
+                m_pool->release(m_host, std::move(m_client));
+            }
+        }
+
+        ClientPool* m_pool = nullptr;
+        std::string m_host;
+        std::unique_ptr<TClient> m_client;
+    };
+
+    ClientPool(Factory factory, std::size_t pool_size, std::chrono::milliseconds idle_timeout)
+        : m_factory(std::move(factory))
+        , m_pool_size(pool_size)
+        , m_idle_timeout(idle_timeout) {
+    }
+
+    Lease acquire(std::string const& host) {
+        std::unique_ptr<TClient> client;
+        {
+            std::scoped_lock const lock(m_mutex);
+            auto& idle = m_idle[host];
+
+            auto const now = Clock::now();
+
+            // Clients are returned to the back, so the expired ones are in
+            // the front
+            auto const expired =
+                std::ranges::find_if(idle, [this, now](auto const& idle_client) {
+                    return now - idle_client.since < m_idle_timeout;
+                });
+            m_expired += std::distance(idle.begin(), expired);
+            idle.erase(idle.begin(), expired);
+
+            if (!idle.empty()) {
+                client = std::move(idle.back().client);
+                idle.pop_back();
+            }
+        }
+
+        if (client && client->is_socket_open()) {
+            ++m_reused;
+        } else {
+            // Either a new client or one whose connection was closed by the
+            // server, both connect on the next request
+            ++m_handshakes;
+        }
+
+        if (!client) {
+            client = m_factory(host);
+        }
+
+        return Lease(this, host, std::move(client));
+    }
+
+    Stats stats() const {
+        return {.reused = m_reused, .handshakes = m_handshakes, .expired = m_expired};
+    }
+
+private:
+    struct IdleClient {
+        std::unique_ptr<TClient> client;
+        Clock::time_point since;
+    };
+
+    void release(std::string const& host, std::unique_ptr<TClient> client) {
+        std::scoped_lock const lock(m_mutex);
+        auto& idle = m_idle[host];
+
+        if (idle.size() >= m_pool_size) {
+            return;
+        }
+
+        idle.emplace_back(IdleClient {std::move(client), Clock::now()});
+    }
+
+    Factory m_factory;
+    std::size_t m_pool_size;
+    std::chrono::milliseconds m_idle_timeout;
+
+    std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, std::vector<IdleClient>> m_idle;
+
+    std::atomic<uint64_t> m_reused = 0;
+    std::atomic<uint64_t> m_handshakes = 0;
+    std::atomic<uint64_t> m_expired = 0;
+};
+
+} // namespace bxt::Utilities::Http
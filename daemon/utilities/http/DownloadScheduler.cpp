@@ -0,0 +1,186 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "DownloadScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace bxt::Utilities::Http {
+
+DownloadScheduler::Permit::Permit(DownloadScheduler* scheduler, std::string host)
+    : m_scheduler(scheduler)
+    , m_host(std::move(host))
+    , m_started(Clock::now()) {
+}
+
+DownloadScheduler::Permit::Permit(Permit&& other) noexcept
+    : m_scheduler(std::exchange(other.m_scheduler, nullptr))
+    , m_host(std::move(other.m_host))
+    , m_started(other.m_started) {
+}
+
+DownloadScheduler::Permit& DownloadScheduler::Permit::operator=(Permit&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_scheduler = std::exchange(other.m_scheduler, nullptr);
+        m_host = std::move(other.m_host);
+        m_started = other.m_started;
+    }
+    return *this;
+}
+
+DownloadScheduler::Permit::~Permit() {
+    release();
+}
+
+double DownloadScheduler::Permit::record(uint64_t bytes) {
+    auto const elapsed = Clock::now() - m_started;
+
+    if (m_scheduler) {
+        m_scheduler->record(bytes, elapsed);
+    }
+
+    auto const seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? static_cast<double>(bytes) / seconds : 0;
+}
+
+void DownloadScheduler::Permit::release() {
+    if (auto scheduler = std::exchange(m_scheduler, nullptr)) {
+        scheduler->release(m_host);
+    }
+}
+
+DownloadScheduler::DownloadScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                                     std::size_t max_downloads,
+                                     std::size_t max_downloads_per_host)
+    : m_scheduler(std::move(scheduler))
+    , m_max_downloads(std::max<std::size_t>(max_downloads, 1))
+    , m_max_downloads_per_host(std::max<std::size_t>(max_downloads_per_host, 1)) {
+}
+
+coro::task<DownloadScheduler::Permit> DownloadScheduler::acquire(std::string queue,
+                                                                 std::string host) {
+    co_await Awaiter {*this, std::move(queue), host};
+
+    // The waiter is resumed by whoever released the slot, move off its thread
+    co_await m_scheduler->schedule();
+
+    co_return Permit(this, std::move(host));
+}
+
+bool DownloadScheduler::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+    // The awaiter lives in the suspended frame that may be resumed as soon as
+    // the lock is released, so only locals are used after that
+    auto& self = scheduler;
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::scoped_lock const lock(self.m_mutex);
+
+        auto& waiters = self.m_queues[queue];
+        if (waiters.empty()) {
+            self.m_round.push_back(queue);
+        }
+        waiters.push_back(Waiter {.host = host, .handle = handle});
+        ++self.m_stats.waiting;
+
+        ready = self.dispatch();
+    }
+
+    bool suspend = true;
+    for (auto const ready_handle : ready) {
+        if (ready_handle == handle) {
+            suspend = false;
+            continue;
+        }
+        ready_handle.resume();
+    }
+
+    return suspend;
+}
+
+std::vector<std::coroutine_handle<>> DownloadScheduler::dispatch() {
+    std::vector<std::coroutine_handle<>> ready;
+
+    while (m_stats.in_flight < m_max_downloads && !m_round.empty()) {
+        bool started = false;
+
+        for (std::size_t i = 0; i < m_round.size() && !started; ++i) {
+            auto queue = std::move(m_round.front());
+            m_round.pop_front();
+
+            auto& waiters = m_queues[queue];
+            auto const& next = waiters.front();
+
+            if (can_start(next.host)) {
+                ++m_host_in_flight[next.host];
+                ++m_stats.in_flight;
+                --m_stats.waiting;
+                m_stats.peak_in_flight = std::max(m_stats.peak_in_flight, m_stats.in_flight);
+
+                ready.push_back(next.handle);
+                waiters.pop_front();
+                started = true;
+            }
+
+            // The queue goes to the back of the round either way, so the
+            // slot after this one is offered to the other queues first
+            if (waiters.empty()) {
+                m_queues.erase(queue);
+            } else {
+                m_round.push_back(std::move(queue));
+            }
+        }
+
+        if (!started) {
+            break;
+        }
+    }
+
+    return ready;
+}
+
+bool DownloadScheduler::can_start(std::string const& host) const {
+    auto const host_it = m_host_in_flight.find(host);
+
+    return host_it == m_host_in_flight.end() || host_it->second < m_max_downloads_per_host;
+}
+
+void DownloadScheduler::release(std::string const& host) {
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::scoped_lock const lock(m_mutex);
+
+        if (auto host_it = m_host_in_flight.find(host); host_it != m_host_in_flight.end()) {
+            if (--host_it->second == 0) {
+                m_host_in_flight.erase(host_it);
+            }
+        }
+        --m_stats.in_flight;
+
+        ready = dispatch();
+    }
+
+    for (auto const handle : ready) {
+        handle.resume();
+    }
+}
+
+void DownloadScheduler::record(uint64_t bytes, Clock::duration elapsed) {
+    std::scoped_lock const lock(m_mutex);
+
+    ++m_stats.downloads;
+    m_stats.bytes += bytes;
+    m_stats.busy += std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+}
+
+DownloadScheduler::Stats DownloadScheduler::stats() const {
+    std::scoped_lock const lock(m_mutex);
+
+    return m_stats;
+}
+
+} // namespace bxt::Utilities::Http
@@ -0,0 +1,115 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/task.hpp>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <vector>
+
+namespace bxt::Utilities::Http {
+
+// Limits how many downloads run at once, both in total and per host.
+// Downloads waiting for a slot are suspended, so they don't hold a thread.
+// Waiting downloads are grouped in queues (one per repository section) and
+// slots are handed out round-robin between the queues, so one big section
+// can't starve the others.
+class DownloadScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t downloads = 0;
+        uint64_t bytes = 0;
+        // Sum of the durations of all recorded downloads
+        std::chrono::milliseconds busy {0};
+        std::size_t in_flight = 0;
+        std::size_t peak_in_flight = 0;
+        std::size_t waiting = 0;
+    };
+
+    // A running download slot, released when the permit is destroyed
+    class Permit {
+    public:
+        Permit(DownloadScheduler* scheduler, std::string host);
+        Permit(Permit&& other) noexcept;
+        Permit& operator=(Permit&& other) noexcept;
+        Permit(Permit const&) = delete;
+        Permit& operator=(Permit const&) = delete;
+        ~Permit();
+
+        // Records a finished transfer for the throughput statistics and
+        // returns its rate in bytes per second
+        double record(uint64_t bytes);
+
+        Clock::duration elapsed() const {
+            return Clock::now() - m_started;
+        }
+
+    private:
+        void release();
+
+        DownloadScheduler* m_scheduler = nullptr;
+        std::string m_host;
+        Clock::time_point m_started;
+    };
+
+    DownloadScheduler(std::shared_ptr<coro::io_scheduler> scheduler,
+                      std::size_t max_downloads,
+                      std::size_t max_downloads_per_host);
+
+    // Waits for a download slot for the host. The caller is resumed on the
+    // io_scheduler, not on the thread that released the slot.
+    coro::task<Permit> acquire(std::string queue, std::string host);
+
+    Stats stats() const;
+
+private:
+    struct Waiter {
+        std::string host;
+        std::coroutine_handle<> handle;
+    };
+
+    struct Awaiter {
+        DownloadScheduler& scheduler;
+        std::string queue;
+        std::string host;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {
+        }
+    };
+
+    // Hands out free slots to the waiters, returns the ones to resume
+    std::vector<std::coroutine_handle<>> dispatch();
+    bool can_start(std::string const& host) const;
+    void release(std::string const& host);
+    void record(uint64_t bytes, Clock::duration elapsed);
+
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+    std::size_t m_max_downloads;
+    std::size_t m_max_downloads_per_host;
+
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, std::deque<Waiter>> m_queues;
+    // Queues with waiters, in the order they get the next slot
+    std::deque<std::string> m_round;
+    phmap::flat_hash_map<std::string, std::size_t> m_host_in_flight;
+    Stats m_stats;
+};
+
+} // namespace bxt::Utilities::Http
@@ -0,0 +1,207 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "MirrorSelector.h"
+
+#include <algorithm>
+
+namespace bxt::Utilities::Http {
+
+namespace {
+    // Weight of a new measurement in the moving averages
+    constexpr double smoothing = 0.3;
+
+    void update_average(std::optional<double>& average, double value) {
+        average = average ? *average * (1 - smoothing) + value * smoothing : value;
+    }
+} // namespace
+
+MirrorSelector::MirrorSelector()
+    : MirrorSelector(Options {}) {
+}
+
+MirrorSelector::MirrorSelector(Options options)
+    : m_options(std::move(options)) {
+}
+
+std::string MirrorSelector::select(std::span<std::string const> mirrors) {
+    if (mirrors.empty()) {
+        return {};
+    }
+    if (mirrors.size() == 1) {
+        return mirrors.front();
+    }
+
+    std::scoped_lock const lock(m_mutex);
+
+    auto const now = Clock::now();
+
+    // Mirrors that weren't measured yet are assumed to be average, so they
+    // get their share of downloads and are measured too
+    double latency_sum = 0;
+    double throughput_sum = 0;
+    std::size_t latency_count = 0;
+    std::size_t throughput_count = 0;
+
+    for (auto const& mirror : mirrors) {
+        auto const& state = m_states[mirror];
+
+        if (state.latency_ms) {
+            latency_sum += *state.latency_ms;
+            ++latency_count;
+        }
+        if (state.throughput) {
+            throughput_sum += *state.throughput;
+            ++throughput_count;
+        }
+    }
+
+    auto const mean_latency = latency_count > 0 ? latency_sum / latency_count : 0.0;
+    auto const mean_throughput = throughput_count > 0 ? throughput_sum / throughput_count : 0.0;
+
+    std::vector<double> weights;
+    weights.reserve(mirrors.size());
+
+    for (auto const& mirror : mirrors) {
+        auto const& state = m_states[mirror];
+
+        if (is_open(state, now)) {
+            weights.push_back(0);
+            continue;
+        }
+
+        auto const latency = state.latency_ms.value_or(mean_latency);
+        auto const throughput = state.throughput.value_or(mean_throughput);
+
+        auto const expected_ms =
+            latency
+            + (throughput > 0 ? static_cast<double>(m_options.typical_download_size) * 1000.0
+                                    / throughput
+                              : 0.0);
+
+        // Every failure in a row halves the share of a mirror before its
+        // breaker opens
+        auto const penalty = static_cast<double>(
+            uint64_t {1} << std::min<std::size_t>(state.consecutive_failures, 16));
+
+        weights.push_back(1.0 / std::max(expected_ms, 1.0) / penalty);
+    }
+
+    if (std::ranges::all_of(weights, [](double weight) { return weight == 0; })) {
+        auto const closest = std::ranges::min_element(mirrors, {}, [this](auto const& mirror) {
+            return m_states[mirror].open_until;
+        });
+
+        return *closest;
+    }
+
+    std::discrete_distribution<std::size_t> distribution(weights.begin(), weights.end());
+
+    auto const& selected = mirrors[distribution(m_random)];
+
+    // Nothing else goes to a half-open mirror until its trial is over
+    if (auto& state = m_states[selected];
+        state.consecutive_failures >= m_options.failure_threshold) {
+        state.trial_until = now + m_options.cooldown;
+    }
+
+    return selected;
+}
+
+bool MirrorSelector::claim_probe(std::string const& mirror) {
+    std::scoped_lock const lock(m_mutex);
+
+    auto const now = Clock::now();
+    auto& state = m_states[mirror];
+
+    if (is_open(state, now) || (state.probed && now < state.probed_at + m_options.cooldown)) {
+        return false;
+    }
+
+    state.probed = true;
+    state.probed_at = now;
+
+    return true;
+}
+
+void MirrorSelector::record_probe(std::string const& mirror,
+                                  std::optional<Clock::duration> latency) {
+    std::scoped_lock const lock(m_mutex);
+
+    auto& state = m_states[mirror];
+
+    if (!latency) {
+        fail(state);
+        return;
+    }
+
+    update_average(state.latency_ms,
+                   std::chrono::duration<double, std::milli>(*latency).count());
+}
+
+void MirrorSelector::record_success(std::string const& mirror, double throughput) {
+    std::scoped_lock const lock(m_mutex);
+
+    auto& state = m_states[mirror];
+
+    state.consecutive_failures = 0;
+    state.open_until = {};
+    state.trial_until = {};
+
+    if (throughput > 0) {
+        update_average(state.throughput, throughput);
+    }
+}
+
+void MirrorSelector::record_failure(std::string const& mirror) {
+    std::scoped_lock const lock(m_mutex);
+
+    fail(m_states[mirror]);
+}
+
+std::vector<MirrorSelector::MirrorStats>
+    MirrorSelector::stats(std::span<std::string const> mirrors) const {
+    std::scoped_lock const lock(m_mutex);
+
+    auto const now = Clock::now();
+
+    std::vector<MirrorStats> result;
+    result.reserve(mirrors.size());
+
+    for (auto const& mirror : mirrors) {
+        MirrorStats stats {.url = mirror};
+
+        if (auto const state = m_states.find(mirror); state != m_states.end()) {
+            if (state->second.latency_ms) {
+                stats.latency = std::chrono::milliseconds(
+                    static_cast<int64_t>(*state->second.latency_ms));
+            }
+            stats.throughput = state->second.throughput.value_or(0);
+            stats.consecutive_failures = state->second.consecutive_failures;
+            stats.available = !is_open(state->second, now);
+        }
+
+        result.emplace_back(std::move(stats));
+    }
+
+    return result;
+}
+
+void MirrorSelector::fail(State& state) {
+    ++state.consecutive_failures;
+
+    if (state.consecutive_failures >= m_options.failure_threshold) {
+        state.open_until = Clock::now() + m_options.cooldown;
+        state.trial_until = {};
+    }
+}
+
+bool MirrorSelector::is_open(State const& state, Clock::time_point now) const {
+    return state.consecutive_failures >= m_options.failure_threshold
+           && (now < state.open_until || now < state.trial_until);
+}
+
+} // namespace bxt::Utilities::Http
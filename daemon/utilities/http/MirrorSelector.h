@@ -0,0 +1,96 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace bxt::Utilities::Http {
+
+// Picks the mirror to download from out of the mirrors of a source, using
+// what is known about every mirror: the latency measured by probes and the
+// throughput of the finished downloads.
+//
+// Mirrors are chosen at random, weighted by the time a typical download
+// would take from them, so the faster mirrors get most of the downloads
+// and the rest is spread over the others. A mirror that failed too many
+// times in a row is skipped for a cooldown (the circuit breaker is open).
+// After the cooldown it's half-open: it's selected for a single trial
+// request and skipped again until its result is in. A success closes the
+// breaker, a failure opens it again. A trial with no result, e.g. a
+// cancelled one, lets another one through after a cooldown.
+class MirrorSelector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Consecutive failures that open the breaker of a mirror
+        std::size_t failure_threshold = 3;
+        std::chrono::milliseconds cooldown {30000};
+        // Size of the download the mirrors are compared by
+        uint64_t typical_download_size = 1024 * 1024;
+    };
+
+    struct MirrorStats {
+        std::string url;
+        std::optional<std::chrono::milliseconds> latency;
+        // Bytes per second, 0 if nothing was downloaded from it yet
+        double throughput = 0;
+        std::size_t consecutive_failures = 0;
+        bool available = true;
+    };
+
+    MirrorSelector();
+    explicit MirrorSelector(Options options);
+
+    // Never empty for a non-empty list: if every breaker is open, the mirror
+    // that is closest to its retry is returned
+    std::string select(std::span<std::string const> mirrors);
+
+    // Whether the mirror is due for a probe, i.e. it wasn't probed during
+    // the last cooldown and its breaker is not open. A true result counts as
+    // the probe being started.
+    bool claim_probe(std::string const& mirror);
+
+    // A probe result, std::nullopt if the mirror didn't respond
+    void record_probe(std::string const& mirror, std::optional<Clock::duration> latency);
+    // A finished download and its rate in bytes per second
+    void record_success(std::string const& mirror, double throughput);
+    void record_failure(std::string const& mirror);
+
+    std::vector<MirrorStats> stats(std::span<std::string const> mirrors) const;
+
+private:
+    struct State {
+        std::optional<double> latency_ms;
+        std::optional<double> throughput;
+        std::size_t consecutive_failures = 0;
+        Clock::time_point open_until;
+        // Set when a half-open mirror is selected for its trial
+        Clock::time_point trial_until;
+        Clock::time_point probed_at;
+        bool probed = false;
+    };
+
+    void fail(State& state);
+    bool is_open(State const& state, Clock::time_point now) const;
+
+    Options m_options;
+
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, State> m_states;
+    std::mt19937 m_random {std::random_device {}()};
+};
+
+} // namespace bxt::Utilities::Http
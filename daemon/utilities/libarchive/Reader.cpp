@@ -9,6 +9,7 @@
 #include "utilities/libarchive/Error.h"
 
 #include <archive.h>
+#include <cerrno>
 #include <variant>
 
 namespace Archive {
@@ -42,6 +43,31 @@ Reader::Result<void> Reader::open_memory(uint8_t* data, size_t length) {
     return {};
 }
 
+Reader::Result<void> Reader::open_callback(ReadCallback callback) {
+    m_read_callback = std::make_unique<ReadCallback>(std::move(callback));
+
+    auto const read = [](struct archive* archive, void* client_data,
+                         void const** buffer) -> la_ssize_t {
+        auto const size = (*static_cast<ReadCallback*>(client_data))(buffer);
+
+        // libarchive only reports what was set as the error, a bare -1 would
+        // come out as an empty message
+        if (size < 0) {
+            archive_set_error(archive, EIO, "Can't read the archive data");
+        }
+
+        return size;
+    };
+
+    int status = archive_read_open(m_archive.get(), m_read_callback.get(), nullptr, read, nullptr);
+
+    if (status != ARCHIVE_OK) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
 Reader::Entry::Result<std::vector<uint8_t>> Reader::Entry::read_all() {
     constexpr int block_size = 1024;
     std::array<uint8_t, block_size> buffer;
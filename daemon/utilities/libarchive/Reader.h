@@ -14,6 +14,7 @@
 #include <array>
 #include <expected>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
@@ -147,12 +148,17 @@ public:
         archive* m_archive = nullptr;
     };
 
+    // Provides the next block of the archive: points the buffer to the data
+    // and returns its size, 0 on the end of the data or -1 on error
+    using ReadCallback = std::function<la_ssize_t(void const** buffer)>;
+
     Reader() = default;
     BXT_DECLARE_RESULT(LibArchiveError)
 
     Result<void> open_filename(std::filesystem::path const& path);
     Result<void> open_memory(std::vector<uint8_t> const& byte_array);
     Result<void> open_memory(uint8_t* data, size_t length);
+    Result<void> open_callback(ReadCallback callback);
 
     struct archive* archive() {
         return m_archive.get();
@@ -181,6 +187,8 @@ public:
     }
 
 private:
+    // Should outlive the archive as it's used as the client data
+    std::unique_ptr<ReadCallback> m_read_callback;
     std::unique_ptr<struct archive, decltype(&archive_read_free)> m_archive {archive_read_new(),
                                                                              archive_read_free};
 };
@@ -34,7 +34,7 @@ public:
         m_dbi = name.empty() ? lmdb::dbi::open(txn->value, nullptr, MDB_CREATE)
                              : lmdb::dbi::open(txn->value, name, MDB_CREATE);
 
-        txn->value.commit();
+        coro::sync_wait(m_env->commit_rw_txn(*txn));
     }
     coro::task<Result<bool>> put(lmdb::txn& txn, std::string_view key, TEntity const value) {
         bool result;
@@ -107,6 +107,16 @@ public:
         accept(lmdb::txn& txn,
                std::function<NavigationAction(std::string_view key, TEntity const& value)> visitor,
                std::string_view prefix = "") {
+        co_return co_await accept_as<TEntity, TSerializer>(txn, std::move(visitor), prefix);
+    }
+
+    // Visits the values read as TView, a type that loads the data of
+    // TEntity or a part of it, e.g. to skip large fields
+    template<typename TView, typename TViewSerializer = CerealSerializer<TView>>
+    coro::task<Result<void>>
+        accept_as(lmdb::txn& txn,
+                  std::function<NavigationAction(std::string_view key, TView const& value)> visitor,
+                  std::string_view prefix = "") {
         {
             auto cursor = lmdb::cursor::open(txn, m_dbi);
 
@@ -123,7 +133,7 @@ public:
             }
 
             do {
-                auto res = TSerializer::deserialize(std::string(value));
+                auto res = TViewSerializer::deserialize(std::string(value));
 
                 if (!res.has_value()) {
                     co_return bxt::make_error_with_source<DatabaseError>(
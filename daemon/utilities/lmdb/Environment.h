@@ -8,43 +8,114 @@
 
 #include "utilities/locked.h"
 
+#include <atomic>
 #include <coro/io_scheduler.hpp>
 #include <coro/mutex.hpp>
 #include <coro/shared_mutex.hpp>
 #include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
 #include <kangaru/autowire.hpp>
 #include <lmdbxx/lmdb++.h>
 #include <memory>
+#include <optional>
+#include <thread>
 
 namespace bxt::Utilities::LMDB {
 class Environment {
 public:
     Environment(std::shared_ptr<coro::io_scheduler> scheduler)
         : m_env(lmdb::env::create())
+        , m_scheduler(scheduler)
         , m_mutex(scheduler) {
     }
 
+    // The writer lock of LMDB belongs to the thread that began the write
+    // transaction, while a coroutine may be resumed on any thread of the
+    // scheduler. So write transactions are begun, committed and aborted on
+    // the writer thread only. The caller runs there while the transaction
+    // is open and is moved back to the scheduler once it's finished.
     coro::task<std::unique_ptr<locked<lmdb::txn>>> begin_rw_txn() {
-        auto result =
-            std::make_unique<locked<lmdb::txn>>(co_await m_mutex.lock(), lmdb::txn::begin(m_env));
+        auto lock = co_await m_mutex.lock();
+        co_await schedule_writer();
 
-        co_return result;
+        co_return std::make_unique<locked<lmdb::txn>>(std::move(lock), lmdb::txn::begin(m_env));
+    }
+
+    coro::task<void> commit_rw_txn(locked<lmdb::txn>& txn) {
+        co_await schedule_writer();
+
+        txn.value.commit();
+        txn.lock.reset();
+
+        co_await m_scheduler->schedule();
     }
 
+    coro::task<void> abort_rw_txn(locked<lmdb::txn>& txn) {
+        co_await schedule_writer();
+
+        txn.value.abort();
+        txn.lock.reset();
+
+        co_await m_scheduler->schedule();
+    }
+
+    // In concurrent mode read transactions rely on LMDB MVCC snapshots and
+    // never wait for the writer. Only write transactions are serialized.
     coro::task<std::unique_ptr<locked<lmdb::txn>>> begin_ro_txn() {
+        if (m_concurrent_reads) {
+            co_return std::make_unique<locked<lmdb::txn>>(
+                std::nullopt, lmdb::txn::begin(m_env, nullptr, MDB_RDONLY));
+        }
+
         auto result = std::make_unique<locked<lmdb::txn>>(
             co_await m_mutex.lock_shared(), lmdb::txn::begin(m_env, nullptr, MDB_RDONLY));
 
         co_return result;
     }
 
+    // Has to be set before the environment is opened: concurrent reads
+    // require the environment to be opened with MDB_NOTLS as read
+    // transactions can be resumed on a different thread than the one they
+    // were started on.
+    void set_concurrent_reads(bool concurrent_reads) {
+        m_concurrent_reads = concurrent_reads;
+    }
+
+    bool concurrent_reads() const {
+        return m_concurrent_reads;
+    }
+
+    unsigned int open_flags() const {
+        return m_concurrent_reads ? MDB_NOTLS : 0;
+    }
+
     lmdb::env& env() {
         return m_env;
     }
 
 private:
+    coro::task<void> schedule_writer() {
+        // Already there, e.g. a transaction finished right after it began
+        if (std::this_thread::get_id() == m_writer_thread.load(std::memory_order_acquire)) {
+            co_return;
+        }
+
+        co_await m_writer.schedule();
+    }
+
     lmdb::env m_env;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
     coro::shared_mutex<coro::io_scheduler> m_mutex;
+    bool m_concurrent_reads = false;
+
+    std::atomic<std::thread::id> m_writer_thread;
+    coro::thread_pool m_writer {coro::thread_pool::options {
+        .thread_count = 1,
+        .on_thread_start_functor =
+            [this](std::size_t) {
+                m_writer_thread.store(std::this_thread::get_id(), std::memory_order_release);
+            },
+    }};
 };
 
 } // namespace bxt::Utilities::LMDB
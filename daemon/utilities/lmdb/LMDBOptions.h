@@ -9,6 +9,7 @@
 
 #include "utilities/configuration/Configuration.h"
 
+#include <cstdint>
 #include <filesystem>
 namespace bxt::Utilities::LMDB {
 
@@ -17,11 +18,19 @@ struct LMDBOptions {
     virtual ~LMDBOptions() = default;
     std::filesystem::path lmdb_path = "bxtd.lmdb";
 
+    // Let read transactions proceed while a write transaction is open
+    bool concurrent_reads = true;
+    int64_t max_readers = 512;
+
     void serialize(Configuration& config) {
         config.set("lmdb-path", lmdb_path.string());
+        config.set("lmdb-concurrent-reads", concurrent_reads);
+        config.set("lmdb-max-readers", max_readers);
     }
     void deserialize(Configuration const& config) {
         lmdb_path = config.get<std::string>("lmdb-path").value_or(lmdb_path);
+        concurrent_reads = config.get<bool>("lmdb-concurrent-reads").value_or(concurrent_reads);
+        max_readers = config.get<int64_t>("lmdb-max-readers").value_or(max_readers);
     }
 };
 
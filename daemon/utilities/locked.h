@@ -10,9 +10,12 @@
 
 #include <coro/mutex.hpp>
 #include <coro/shared_mutex.hpp>
+#include <optional>
 namespace bxt::Utilities {
+// Value guarded by a scoped lock. The lock is optional so lock-free values
+// (e.g. MVCC read transactions) can share the same type.
 template<typename T> struct locked {
-    coro::shared_scoped_lock<coro::io_scheduler> lock;
+    std::optional<coro::shared_scoped_lock<coro::io_scheduler>> lock;
 
     T value;
 };
@@ -0,0 +1,44 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#pragma once
+
+#include "utilities/configuration/Configuration.h"
+
+#include <algorithm>
+#include <coro/io_scheduler.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace bxt::Utilities {
+
+// Injectable options for the shared io_scheduler. The scheduler runs its own
+// event thread and resumes tasks on a dedicated thread pool, so timers and
+// scheduled tasks are not tied to any external polling loop. A task may be
+// resumed on any of the pool threads, which is why LMDB write transactions
+// are pinned to the writer thread of LMDB::Environment.
+struct SchedulerOptions {
+    int64_t thread_count = 4;
+
+    void serialize(Configuration& config) {
+        config.set("scheduler-threads", thread_count);
+    }
+    void deserialize(Configuration const& config) {
+        thread_count = config.get<int64_t>("scheduler-threads").value_or(thread_count);
+    }
+
+    std::shared_ptr<coro::io_scheduler> make_scheduler() const {
+        return coro::io_scheduler::make_shared({
+            .thread_strategy = coro::io_scheduler::thread_strategy_t::spawn,
+            .pool = {.thread_count = static_cast<uint32_t>(std::max<int64_t>(thread_count, 1))},
+            .execution_strategy =
+                coro::io_scheduler::execution_strategy_t::process_tasks_on_thread_pool,
+        });
+    }
+};
+
+} // namespace bxt::Utilities